@@ -0,0 +1,118 @@
+// Copyright (C) 2020  CEA/DEN, EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+#include "AgentProtocol.hxx"
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace WorkloadManager
+{
+namespace AgentProtocol
+{
+  void appendFrame(std::string& out, MessageType type,
+                   const std::string& payload)
+  {
+    putUInt32(out, payload.size());
+    out.push_back(char(type));
+    out.append(payload);
+  }
+
+  FrameStatus extractFrame(std::string& buffer, MessageType& type,
+                           std::string& payload)
+  {
+    if(buffer.size() < HEADER_SIZE)
+      return FRAME_INCOMPLETE;
+    std::size_t pos = 0;
+    std::uint32_t length = getUInt32(buffer, pos);
+    if(length > MAX_PAYLOAD_SIZE)
+      return FRAME_TOO_BIG;
+    if(buffer.size() < HEADER_SIZE + std::size_t(length))
+      return FRAME_INCOMPLETE;
+    type = MessageType(buffer[pos]);
+    payload.assign(buffer, HEADER_SIZE, length);
+    buffer.erase(0, HEADER_SIZE + length);
+    return FRAME_OK;
+  }
+
+  void putUInt32(std::string& out, std::uint32_t value)
+  {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  void putUInt64(std::string& out, std::uint64_t value)
+  {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  std::uint32_t getUInt32(const std::string& in, std::size_t& pos)
+  {
+    std::uint32_t result;
+    std::memcpy(&result, in.data() + pos, sizeof(result));
+    pos += sizeof(result);
+    return result;
+  }
+
+  std::uint64_t getUInt64(const std::string& in, std::size_t& pos)
+  {
+    std::uint64_t result;
+    std::memcpy(&result, in.data() + pos, sizeof(result));
+    pos += sizeof(result);
+    return result;
+  }
+
+  bool writeAll(int fd, const std::string& data)
+  {
+    std::size_t written = 0;
+    while(written < data.size())
+    {
+      // no SIGPIPE if the other end is dead
+      ssize_t n = ::send(fd, data.data() + written, data.size() - written,
+                         MSG_NOSIGNAL);
+      if(n < 0 && errno == EINTR)
+        continue;
+      if(n <= 0)
+        return false;
+      written += n;
+    }
+    return true;
+  }
+
+  int connectTo(const std::string& path)
+  {
+    sockaddr_un address;
+    if(path.size() >= sizeof(address.sun_path))
+      return -1;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0)
+      return -1;
+    if(::connect(fd, reinterpret_cast<sockaddr*>(&address),
+                 sizeof(address)) < 0)
+    {
+      ::close(fd);
+      return -1;
+    }
+    return fd;
+  }
+}
+}
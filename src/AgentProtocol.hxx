@@ -0,0 +1,82 @@
+// Copyright (C) 2020  CEA/DEN, EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+#ifndef AGENTPROTOCOL_H
+#define AGENTPROTOCOL_H
+
+#include <string>
+#include <cstdint>
+
+namespace WorkloadManager
+{
+/**
+ * Binary framing of the messages exchanged over a local socket between an
+ * AgentServer and its WorkerAgent processes. A frame is a header (payload
+ * length on 4 bytes and message type on 1 byte) followed by the payload.
+ * Integers are in the byte order of the host, because both ends are on the
+ * same machine.
+ *
+ * Messages:
+ *   - REGISTER (agent -> server): name of the resource served by the agent.
+ *   - LAUNCH (server -> agent): launch id (8 bytes), container index
+ *     (4 bytes) and the descriptor of the task (remaining bytes).
+ *   - DONE (agent -> server): number of completions (4 bytes) followed by
+ *     the launch id (8 bytes) and the status (4 bytes) of every completion.
+ *     Completions are acknowledged by batches.
+ */
+namespace AgentProtocol
+{
+  enum MessageType : std::uint8_t
+  {
+    REGISTER = 1,
+    LAUNCH = 2,
+    DONE = 3
+  };
+
+  constexpr std::size_t HEADER_SIZE = 5;
+  // A bigger frame is an error: the peer cannot make the other end buffer
+  // without limit.
+  constexpr std::uint32_t MAX_PAYLOAD_SIZE = 16 << 20;
+
+  enum FrameStatus
+  {
+    FRAME_OK,
+    FRAME_INCOMPLETE, // wait for more data
+    FRAME_TOO_BIG // the connection has to be closed
+  };
+
+  void appendFrame(std::string& out, MessageType type,
+                   const std::string& payload);
+  // Remove the first complete frame from the buffer.
+  FrameStatus extractFrame(std::string& buffer, MessageType& type,
+                           std::string& payload);
+
+  void putUInt32(std::string& out, std::uint32_t value);
+  void putUInt64(std::string& out, std::uint64_t value);
+  // Read at pos and move pos after the value. The caller checks that the
+  // value is in the buffer.
+  std::uint32_t getUInt32(const std::string& in, std::size_t& pos);
+  std::uint64_t getUInt64(const std::string& in, std::size_t& pos);
+
+  // Write the whole buffer. Return false if the connection is lost.
+  bool writeAll(int fd, const std::string& data);
+  // Return a socket connected to the unix socket path, or -1.
+  int connectTo(const std::string& path);
+}
+}
+#endif // AGENTPROTOCOL_H
@@ -0,0 +1,276 @@
+// Copyright (C) 2020  CEA/DEN, EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+#include "AgentServer.hxx"
+#include "AgentProtocol.hxx"
+#include <stdexcept>
+#include <vector>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace WorkloadManager
+{
+constexpr int AgentServer::AGENT_LOST;
+constexpr int AgentServer::NO_AGENT;
+
+AgentServer::AgentServer(const std::string& socketPath)
+: _socketPath(socketPath)
+, _listenFd(-1)
+, _wakeUpPipe{-1, -1}
+, _mutex()
+, _condition()
+, _connections()
+, _agents()
+, _pendingLaunches()
+, _nextLaunchId(0)
+, _serverThread()
+{
+  sockaddr_un address;
+  if(socketPath.size() >= sizeof(address.sun_path))
+    throw std::runtime_error("Socket path too long: " + socketPath);
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  std::strncpy(address.sun_path, socketPath.c_str(),
+               sizeof(address.sun_path) - 1);
+  ::unlink(socketPath.c_str());
+  _listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if(_listenFd < 0
+     || ::bind(_listenFd, reinterpret_cast<sockaddr*>(&address),
+               sizeof(address)) < 0
+     || ::listen(_listenFd, SOMAXCONN) < 0
+     || ::pipe(_wakeUpPipe) < 0)
+  {
+    std::string message = std::strerror(errno);
+    if(_listenFd >= 0)
+      ::close(_listenFd);
+    throw std::runtime_error("Cannot listen on " + socketPath + ": "
+                             + message);
+  }
+  _serverThread = std::thread([this]
+    {
+      serve();
+    });
+}
+
+AgentServer::~AgentServer()
+{
+  char c = 0;
+  while(::write(_wakeUpPipe[1], &c, 1) < 0 && errno == EINTR);
+  _serverThread.join();
+  std::vector<int> fds;
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    for(const std::pair<const int, std::shared_ptr<Connection> >& connection
+        : _connections)
+      fds.push_back(connection.first);
+  }
+  for(int fd : fds)
+    closeConnection(fd);
+  // The launches are ended by closeConnection, but their threads still
+  // use the mutex and the condition.
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _condition.wait(lock, [this] {return _pendingLaunches.empty();});
+  }
+  ::close(_listenFd);
+  ::close(_wakeUpPipe[0]);
+  ::close(_wakeUpPipe[1]);
+  ::unlink(_socketPath.c_str());
+}
+
+bool AgentServer::waitAgent(const std::string& resourceName,
+                            const std::chrono::milliseconds& timeout)
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  return _condition.wait_for(lock, timeout, [this, &resourceName]
+    {
+      return _agents.find(resourceName) != _agents.end();
+    });
+}
+
+int AgentServer::launch(const RunInfo& worker, const std::string& descriptor)
+{
+  std::shared_ptr<Connection> agent;
+  std::uint64_t launchId = 0;
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    std::map<std::string, std::shared_ptr<Connection> >::iterator it;
+    if(worker.resource)
+      it = _agents.find(worker.resource->name);
+    if(worker.resource == nullptr || it == _agents.end())
+      return NO_AGENT;
+    agent = it->second;
+    launchId = _nextLaunchId;
+    _nextLaunchId++;
+    _pendingLaunches[launchId].fd = agent->fd;
+  }
+
+  std::string payload;
+  AgentProtocol::putUInt64(payload, launchId);
+  AgentProtocol::putUInt32(payload, worker.index);
+  payload.append(descriptor);
+  std::string frame;
+  AgentProtocol::appendFrame(frame, AgentProtocol::LAUNCH, payload);
+  {
+    std::unique_lock<std::mutex> lock(agent->writeMutex);
+    // A failure is seen by the server thread, which ends the launch.
+    if(agent->fd >= 0)
+      AgentProtocol::writeAll(agent->fd, frame);
+  }
+
+  std::unique_lock<std::mutex> lock(_mutex);
+  _condition.wait(lock, [this, launchId]
+    {
+      return _pendingLaunches[launchId].done;
+    });
+  int result = _pendingLaunches[launchId].status;
+  _pendingLaunches.erase(launchId);
+  // the destructor waits for the end of the launches
+  _condition.notify_all();
+  return result;
+}
+
+void AgentServer::serve()
+{
+  bool threadStop = false;
+  while(!threadStop)
+  {
+    std::vector<pollfd> fds;
+    fds.push_back({_wakeUpPipe[0], POLLIN, 0});
+    fds.push_back({_listenFd, POLLIN, 0});
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      for(const std::pair<const int, std::shared_ptr<Connection> >& connection
+          : _connections)
+        fds.push_back({connection.first, POLLIN, 0});
+    }
+    if(::poll(fds.data(), fds.size(), -1) < 0)
+      continue; // EINTR
+    threadStop = fds[0].revents != 0;
+    if(!threadStop && (fds[1].revents & POLLIN))
+    {
+      int fd = ::accept(_listenFd, nullptr, nullptr);
+      if(fd >= 0)
+      {
+        std::shared_ptr<Connection> connection = std::make_shared<Connection>();
+        connection->fd = fd;
+        std::unique_lock<std::mutex> lock(_mutex);
+        _connections.emplace(fd, connection);
+      }
+    }
+    for(std::size_t i = 2; !threadStop && i < fds.size(); i++)
+    {
+      if(fds[i].revents == 0)
+        continue;
+      std::shared_ptr<Connection> connection;
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+        connection = _connections[fds[i].fd];
+      }
+      char data[4096];
+      ssize_t n = ::read(fds[i].fd, data, sizeof(data));
+      if(n < 0 && errno == EINTR)
+        continue;
+      bool ok = n > 0;
+      if(ok)
+      {
+        connection->buffer.append(data, n);
+        ok = processInput(*connection);
+      }
+      if(!ok)
+        closeConnection(fds[i].fd);
+    }
+  }
+}
+
+bool AgentServer::processInput(Connection& connection)
+{
+  AgentProtocol::MessageType type;
+  std::string payload;
+  AgentProtocol::FrameStatus status;
+  while((status = AgentProtocol::extractFrame(connection.buffer, type,
+                                              payload))
+        == AgentProtocol::FRAME_OK)
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if(type == AgentProtocol::REGISTER)
+    {
+      connection.resourceName = payload;
+      _agents[payload] = _connections[connection.fd];
+      _condition.notify_all();
+    }
+    else if(type == AgentProtocol::DONE)
+    {
+      std::size_t pos = 0;
+      if(payload.size() < sizeof(std::uint32_t))
+        return false;
+      std::uint32_t count = AgentProtocol::getUInt32(payload, pos);
+      // no overflow: the count is compared to the size of the payload
+      constexpr std::size_t entrySize = 8 + 4;
+      if(count != (payload.size() - pos) / entrySize
+         || (payload.size() - pos) % entrySize != 0)
+        return false;
+      for(std::uint32_t i = 0; i < count; i++)
+      {
+        std::uint64_t launchId = AgentProtocol::getUInt64(payload, pos);
+        int status = int(AgentProtocol::getUInt32(payload, pos));
+        std::map<std::uint64_t, PendingLaunch>::iterator it;
+        it = _pendingLaunches.find(launchId);
+        // only the agent of the launch can end it
+        if(it != _pendingLaunches.end() && it->second.fd == connection.fd)
+        {
+          it->second.done = true;
+          it->second.status = status;
+        }
+      }
+      _condition.notify_all();
+    }
+    else
+      return false;
+  }
+  return status != AgentProtocol::FRAME_TOO_BIG;
+}
+
+void AgentServer::closeConnection(int fd)
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  std::shared_ptr<Connection> connection = _connections[fd];
+  _connections.erase(fd);
+  std::map<std::string, std::shared_ptr<Connection> >::iterator it;
+  it = _agents.find(connection->resourceName);
+  if(it != _agents.end() && it->second == connection)
+    _agents.erase(it);
+  // the tasks run by this agent are lost
+  for(std::pair<const std::uint64_t, PendingLaunch>& launch : _pendingLaunches)
+    if(launch.second.fd == fd && !launch.second.done)
+    {
+      launch.second.done = true;
+      launch.second.status = AGENT_LOST;
+    }
+  _condition.notify_all();
+  // The fd is not reused while a launch is writing on it.
+  std::unique_lock<std::mutex> writeLock(connection->writeMutex);
+  ::close(fd);
+  connection->fd = -1;
+}
+
+}
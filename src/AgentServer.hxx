@@ -0,0 +1,114 @@
+// Copyright (C) 2020  CEA/DEN, EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+#ifndef AGENTSERVER_H
+#define AGENTSERVER_H
+
+#include "Task.hxx"
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+
+namespace WorkloadManager
+{
+/**
+ * Manager side of the worker agents. Long-lived WorkerAgent processes
+ * connect to the unix socket of the server and register for a resource.
+ * The tasks are then run by the agent of their resource instead of running
+ * in the process of the manager, so a crash of a task does not take the
+ * manager down. See AgentProtocol.hxx for the messages.
+ */
+class AgentServer
+{
+public:
+  // status of a launch when the agent is lost during the run
+  static constexpr int AGENT_LOST = -1;
+  // status of a launch when there is no agent for the resource
+  static constexpr int NO_AGENT = -2;
+
+  // Listen on the unix socket path. Throw std::runtime_error on failure.
+  AgentServer(const std::string& socketPath);
+  AgentServer(const AgentServer&) = delete;
+  // The running launches end with AGENT_LOST. Wait for their return.
+  ~AgentServer();
+  // Wait for an agent to register for the resource.
+  bool waitAgent(const std::string& resourceName,
+                 const std::chrono::milliseconds& timeout);
+  // Send the task to the agent of the resource and wait for its end.
+  // Return the status given by the agent, AGENT_LOST or NO_AGENT.
+  int launch(const RunInfo& worker, const std::string& descriptor);
+
+private:
+  struct Connection
+  {
+    int fd = -1;
+    std::string resourceName; // empty until the agent is registered
+    std::string buffer; // received data not yet processed
+    std::mutex writeMutex;
+  };
+  struct PendingLaunch
+  {
+    int fd;
+    bool done = false;
+    int status = 0;
+  };
+
+  void serve();
+  // Process the received frames. Return false if the connection is broken.
+  bool processInput(Connection& connection);
+  void closeConnection(int fd);
+
+private:
+  std::string _socketPath;
+  int _listenFd;
+  int _wakeUpPipe[2]; // wakes the server thread up at destruction
+  std::mutex _mutex;
+  std::condition_variable _condition; // agent registered or launch done
+  std::map<int, std::shared_ptr<Connection> > _connections; // key is the fd
+  // key is the resource name
+  std::map<std::string, std::shared_ptr<Connection> > _agents;
+  std::map<std::uint64_t, PendingLaunch> _pendingLaunches;
+  std::uint64_t _nextLaunchId;
+  std::thread _serverThread;
+};
+
+/**
+ * Task run by the worker agent of its resource.
+ */
+class RemoteTask : public Task
+{
+public:
+  RemoteTask(AgentServer& server) : _server(server) {}
+  void run(const RunInfo& c)override
+  {
+    finished(_server.launch(c, descriptor()));
+  }
+  // Description of the work to do, sent to the agent.
+  virtual std::string descriptor()const =0;
+  // Called with the status of the run (see AgentServer::launch).
+  virtual void finished(int status){}
+private:
+  AgentServer& _server;
+};
+}
+#endif // AGENTSERVER_H
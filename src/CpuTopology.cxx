@@ -0,0 +1,133 @@
+// Copyright (C) 2020  CEA/DEN, EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+#include "CpuTopology.hxx"
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <algorithm>
+#include <dirent.h>
+#include <sched.h>
+
+namespace WorkloadManager
+{
+CpuTopology CpuTopology::local(const std::string& nodesPath,
+                               const CpuList& allowed)
+{
+  auto isAllowed = [&allowed](int cpu)
+    {
+      return allowed.empty()
+             || std::binary_search(allowed.begin(), allowed.end(), cpu);
+    };
+  CpuTopology result;
+  DIR* dir = opendir(nodesPath.c_str());
+  if(dir)
+  {
+    // The directories are not sorted.
+    std::vector<int> nodeIds;
+    while(struct dirent* entry = readdir(dir))
+    {
+      std::string name = entry->d_name;
+      if(name.size() > 4 && name.compare(0, 4, "node") == 0
+         && name.find_first_not_of("0123456789", 4) == std::string::npos)
+        nodeIds.push_back(std::stoi(name.substr(4)));
+    }
+    closedir(dir);
+    std::sort(nodeIds.begin(), nodeIds.end());
+    for(int id : nodeIds)
+    {
+      std::ifstream cpuListFile(nodesPath + "/node" + std::to_string(id)
+                                + "/cpulist");
+      std::string cpuList;
+      if(std::getline(cpuListFile, cpuList))
+      {
+        CpuList cpus = parseCpuList(cpuList);
+        cpus.erase(std::remove_if(cpus.begin(), cpus.end(),
+                                  [&isAllowed](int cpu)
+                                  {
+                                    return !isAllowed(cpu);
+                                  }),
+                   cpus.end());
+        if(!cpus.empty())
+          result.addNode(cpus);
+      }
+    }
+  }
+  if(result.empty())
+  {
+    CpuList cpus = allowed;
+    if(cpus.empty())
+      for(unsigned int i = 0; i < std::thread::hardware_concurrency(); i++)
+        cpus.push_back(i);
+    result.addNode(cpus);
+  }
+  return result;
+}
+
+CpuTopology::CpuList CpuTopology::allowedCpus()
+{
+  CpuList result;
+  cpu_set_t cpuSet;
+  CPU_ZERO(&cpuSet);
+  if(sched_getaffinity(0, sizeof(cpu_set_t), &cpuSet) == 0)
+    for(int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+      if(CPU_ISSET(cpu, &cpuSet))
+        result.push_back(cpu);
+  return result;
+}
+
+CpuTopology::CpuList CpuTopology::parseCpuList(const std::string& list)
+{
+  CpuList result;
+  std::istringstream input(list);
+  std::string range;
+  while(std::getline(input, range, ','))
+  {
+    std::size_t dash = range.find('-');
+    try
+    {
+      int first = std::stoi(range.substr(0, dash));
+      int last = first;
+      if(dash != std::string::npos)
+        last = std::stoi(range.substr(dash + 1));
+      for(int cpu = first; cpu <= last; cpu++)
+        result.push_back(cpu);
+    }
+    catch(const std::exception&)
+    {
+      // ignore the bad ranges
+    }
+  }
+  return result;
+}
+
+void CpuTopology::addNode(const CpuList& cpus)
+{
+  _nodes.push_back(cpus);
+}
+
+unsigned int CpuTopology::cpusRange()const
+{
+  int result = 0;
+  for(const CpuList& node : _nodes)
+    for(int cpu : node)
+      if(cpu + 1 > result)
+        result = cpu + 1;
+  return result;
+}
+}
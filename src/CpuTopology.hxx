@@ -0,0 +1,58 @@
+// Copyright (C) 2020  CEA/DEN, EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+#ifndef CPUTOPOLOGY_H
+#define CPUTOPOLOGY_H
+
+#include <string>
+#include <vector>
+
+namespace WorkloadManager
+{
+/**
+ * CPUs of a machine grouped by NUMA node. It is used to pin the containers
+ * launched on a resource to CPUs of the same node
+ * (see ResourcePool::setCpuTopology).
+ */
+class CpuTopology
+{
+public:
+  typedef std::vector<int> CpuList;
+  // Read the topology of the local machine from sysfs, restricted to the
+  // allowed CPUs. If it is not available, all the allowed CPUs are in the
+  // same node.
+  static CpuTopology local(const std::string& nodesPath
+                                          = "/sys/devices/system/node",
+                           const CpuList& allowed = allowedCpus());
+  // CPUs of the affinity of the process (see sched_getaffinity). Empty if
+  // it is not known, which means no restriction.
+  static CpuList allowedCpus();
+  // Parse a CPU list in the sysfs format, ex: "0-3,8-11".
+  static CpuList parseCpuList(const std::string& list);
+
+  void addNode(const CpuList& cpus);
+  const std::vector<CpuList>& nodes()const { return _nodes;}
+  bool empty()const { return _nodes.empty();}
+  // Greatest CPU id + 1.
+  unsigned int cpusRange()const;
+
+private:
+  std::vector<CpuList> _nodes;
+};
+}
+#endif // CPUTOPOLOGY_H
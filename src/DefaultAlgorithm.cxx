@@ -18,29 +18,94 @@
 //
 #include "DefaultAlgorithm.hxx"
 #include "Task.hxx"
-#include <stdexcept>
-#include <limits>
 #include <algorithm>
 
 namespace WorkloadManager
 {
+DefaultAlgorithm::DefaultAlgorithm()
+: _resources()
+, _broker(nullptr)
+, _listenerId(-1)
+, _waitingTasks()
+, _runningGangs()
+, _reservingTask(nullptr)
+, _dataSets()
+, _transferCost(100.0)
+, _localityDelay(0)
+, _retryTime(Clock::time_point::max())
+, _placementMode(SPREAD)
+{
+}
+
+DefaultAlgorithm::DefaultAlgorithm(ResourceBroker& broker)
+: _resources()
+, _broker(&broker)
+, _listenerId(-1)
+, _waitingTasks()
+, _runningGangs()
+, _reservingTask(nullptr)
+, _dataSets()
+, _transferCost(100.0)
+, _localityDelay(0)
+, _retryTime(Clock::time_point::max())
+, _placementMode(SPREAD)
+{
+}
+
+DefaultAlgorithm::~DefaultAlgorithm()
+{
+  if(_reservingTask && _broker)
+    _broker->cancelReservation();
+  setResourceListener(nullptr);
+}
+
 void DefaultAlgorithm::addTask(Task* t)
 {
+  WaitingTask newTask;
+  newTask.task = t;
+  newTask.typeHandle = registerType(t->type());
+  for(const LocalityHint& hint : t->localityHints())
+  {
+    if(!hint.resourceName.empty())
+    {
+      const Resource* r = findResource(hint.resourceName);
+      if(r)
+        newTask.locality.emplace_back(r, hint.weight);
+    }
+    if(!hint.dataSet.empty())
+    {
+      auto range = _dataSets.equal_range(hint.dataSet);
+      for(auto it = range.first; it != range.second; it++)
+      {
+        const Resource* r = findResource(it->second);
+        if(r)
+          newTask.locality.emplace_back(r, hint.weight);
+      }
+    }
+  }
   // put the tasks which need more cores in front.
-  float newNeedCores = t->type().neededCores;
+  float newNeedCores = neededCores(t);
   if(_waitingTasks.empty())
-    _waitingTasks.push_back(t);
-  else if(_waitingTasks.back()->type().neededCores >= newNeedCores)
-    _waitingTasks.push_back(t);
+    _waitingTasks.push_back(newTask);
+  else if(neededCores(_waitingTasks.back().task) >= newNeedCores)
+    _waitingTasks.push_back(newTask);
   else
   {
-    std::list<Task*>::iterator it = _waitingTasks.begin();
-    while(it != _waitingTasks.end() && (*it)->type().neededCores >= newNeedCores)
+    std::list<WaitingTask>::iterator it = _waitingTasks.begin();
+    while(it != _waitingTasks.end()
+          && neededCores(it->task) >= newNeedCores)
       it++;
-    _waitingTasks.insert(it, t);
+    _waitingTasks.insert(it, newTask);
   }
 }
 
+ContainerTypeHandle DefaultAlgorithm::registerType(const ContainerType& ctype)
+{
+  if(_broker)
+    return _broker->registerType(ctype);
+  return _resources.registerType(ctype);
+}
+
 bool DefaultAlgorithm::empty()const
 {
   return _waitingTasks.empty();
@@ -48,184 +113,265 @@ bool DefaultAlgorithm::empty()const
 
 void DefaultAlgorithm::addResource(const Resource& r)
 {
-  _resources.emplace_back(r);
+  if(_broker)
+    _broker->addResource(r);
+  else
+    _resources.addResource(r);
 }
 
-WorkloadAlgorithm::LaunchInfo DefaultAlgorithm::chooseTask()
+void DefaultAlgorithm::setDataSetLocation(const std::string& dataSet,
+                                          const std::string& resourceName)
 {
-  LaunchInfo result;
-  std::list<Task*>::iterator chosenTaskIt;
-  for( std::list<Task*>::iterator itTask = _waitingTasks.begin();
-      !result.taskFound && itTask != _waitingTasks.end();
-      itTask ++)
-  {
-    const ContainerType& ctype = (*itTask)->type();
-    if(ctype.ignoreResources)
-      result.taskFound = true;
-    else
-    {
-      std::list<ResourceLoadInfo>::iterator best_resource;
-      best_resource = _resources.end();
-      float best_cost = std::numeric_limits<float>::max();
-      bool isSupported = false;
-      for(auto itResource = _resources.begin();
-          itResource != _resources.end();
-          itResource++)
-        if(itResource->isSupported(ctype)
-            && (*itTask)->isAccepted(itResource->resource()))
-        {
-          if(itResource->isAllocPossible(ctype))
-          {
-            float thisCost = itResource->cost(ctype);
-            if( best_cost > thisCost)
-            {
-              best_cost = thisCost;
-              best_resource = itResource;
-            }
-          }
-        }
-      if(best_resource != _resources.end())
-      {
-        result.taskFound = true;
-        result.worker.resource = best_resource->resource();
-        result.worker.index = best_resource->alloc(ctype);
-      }
-      else if(!isSupported)
-      {
-        // TODO: This task can never be run by any available resource.
-      }
-    }
-    if(result.taskFound)
-    {
-      chosenTaskIt = itTask;
-      result.task = (*itTask);
-      result.worker.type = ctype;
-    }
-  }
-  if(result.taskFound)
-    _waitingTasks.erase(chosenTaskIt);
-  return result;
+  _dataSets.emplace(dataSet, resourceName);
 }
 
-void DefaultAlgorithm::liberate(const LaunchInfo& info)
+std::chrono::steady_clock::time_point DefaultAlgorithm::retryTime()const
 {
-  const ContainerType& ctype = info.worker.type;
-  if(!ctype.ignoreResources)
-  {
-    const Resource& r = info.worker.resource;
-    unsigned int index = info.worker.index;
-    std::list<ResourceLoadInfo>::iterator it = std::find(_resources.begin(),
-                                                        _resources.end(),
-                                                        r);
-    it->free(ctype, index); // we are sure to find it
-  }
+  return _retryTime;
 }
 
-// ResourceInfoForContainer
-
-DefaultAlgorithm::ResourceInfoForContainer::ResourceInfoForContainer
-                                (const Resource& r, const ContainerType& ctype)
-: _ctype(ctype)
-, _resource(r)
-, _runningContainers()
-, _firstFreeContainer(0)
+void DefaultAlgorithm::setTransferCost(float cost)
 {
+  _transferCost = cost;
 }
 
-unsigned int DefaultAlgorithm::ResourceInfoForContainer::maxContainers()const
+void DefaultAlgorithm::setLocalityDelay(const std::chrono::milliseconds& delay)
 {
-  return float(_resource.nbCores) / _ctype.neededCores;
+  _localityDelay = delay;
 }
 
-unsigned int  DefaultAlgorithm::ResourceInfoForContainer::alloc()
+void DefaultAlgorithm::setPlacementMode(PlacementMode mode)
 {
-  unsigned int result = _firstFreeContainer;
-  _runningContainers.insert(result);
-  _firstFreeContainer++;
-  while(isContainerRunning(_firstFreeContainer))
-    _firstFreeContainer++;
-  return result;
+  _placementMode = mode;
 }
 
-void DefaultAlgorithm::ResourceInfoForContainer::free(unsigned int index)
+bool DefaultAlgorithm::setCpuTopology(const std::string& resourceName,
+                                      const CpuTopology& topology)
 {
-  _runningContainers.erase(index);
-  if(index < _firstFreeContainer)
-    _firstFreeContainer = index;
+  if(_broker)
+    return _broker->setCpuTopology(resourceName, topology);
+  return _resources.setCpuTopology(resourceName, topology);
 }
 
-unsigned int DefaultAlgorithm::ResourceInfoForContainer::nbRunningContainers()const
+void DefaultAlgorithm::setResourceListener
+                                (const std::function<void()>& listener)
 {
-  return _runningContainers.size();
+  if(!_broker)
+    return;
+  if(_listenerId >= 0)
+    _broker->removeListener(_listenerId);
+  _listenerId = -1;
+  if(listener)
+    _listenerId = _broker->addListener(listener);
 }
 
-bool DefaultAlgorithm::ResourceInfoForContainer::isContainerRunning
-                                (unsigned int index)const
+WorkloadAlgorithm::LaunchInfo DefaultAlgorithm::chooseTask()
 {
-  return _runningContainers.find(index)!=_runningContainers.end();
+  LaunchInfo result;
+  _retryTime = Clock::time_point::max();
+  std::list<WaitingTask>::iterator chosenTaskIt;
+  for( std::list<WaitingTask>::iterator itTask = _waitingTasks.begin();
+      !result.taskFound && itTask != _waitingTasks.end();
+      itTask ++)
+  {
+    Task* task = itTask->task;
+    if(task->type().ignoreResources)
+    {
+      result.taskFound = true;
+      result.worker.typeHandle = itTask->typeHandle;
+      if(_broker)
+        result.worker.type = _broker->type(itTask->typeHandle);
+      else
+        result.worker.type = _resources.type(itTask->typeHandle);
+    }
+    else if(task->type().gangSize > 1)
+      result.taskFound = allocGang(task, itTask->typeHandle, result.worker);
+    else if(!itTask->locality.empty())
+      result.taskFound = allocLocal(*itTask, result.worker);
+    else if(_placementMode == PACK && _broker)
+      result.taskFound = _broker->leaseBestFit(task, itTask->typeHandle,
+                                               result.worker);
+    else if(_placementMode == PACK)
+      result.taskFound = _resources.allocBestFit(task, itTask->typeHandle,
+                                                 result.worker);
+    else if(_broker)
+      result.taskFound = _broker->lease(task, itTask->typeHandle,
+                                        result.worker);
+    else
+      result.taskFound = _resources.alloc(task, itTask->typeHandle,
+                                          result.worker);
+    if(result.taskFound)
+    {
+      chosenTaskIt = itTask;
+      result.task = task;
+    }
+  }
+  if(result.taskFound)
+    _waitingTasks.erase(chosenTaskIt);
+  return result;
 }
 
-// ResourceLoadInfo
+Task* DefaultAlgorithm::chooseBatchedTask(const LaunchInfo& launched)
+{
+  const RunInfo& worker = launched.worker;
+  if(worker.resource == nullptr || worker.gang != nullptr)
+    return nullptr;
+  for( std::list<WaitingTask>::iterator itTask = _waitingTasks.begin();
+      itTask != _waitingTasks.end();
+      itTask ++)
+    if(itTask->typeHandle == worker.typeHandle
+       && itTask->task->isAccepted(*worker.resource)
+       && isLocal(*itTask, *worker.resource))
+    {
+      Task* result = itTask->task;
+      _waitingTasks.erase(itTask);
+      return result;
+    }
+  return nullptr;
+}
 
-DefaultAlgorithm::ResourceLoadInfo::ResourceLoadInfo(const Resource& r)
-: _resource(r)
-, _load(0.0)
-, _loadCost(0.0)
-, _ctypes()
+Task* DefaultAlgorithm::removeTask(const std::function<bool(Task*)>& accept)
 {
+  // The last tasks are the smallest and the most recent ones.
+  for( std::list<WaitingTask>::reverse_iterator itTask = _waitingTasks.rbegin();
+      itTask != _waitingTasks.rend();
+      itTask ++)
+    if(accept(itTask->task))
+    {
+      Task* result = itTask->task;
+      if(_reservingTask == result)
+      {
+        if(_broker)
+          _broker->cancelReservation();
+        else
+          _resources.cancelReservation();
+        _reservingTask = nullptr;
+      }
+      _waitingTasks.erase(std::next(itTask).base());
+      return result;
+    }
+  return nullptr;
 }
 
-bool DefaultAlgorithm::ResourceLoadInfo::isSupported
-                                (const ContainerType& ctype)const
+void DefaultAlgorithm::liberate(const LaunchInfo& info)
 {
-  return ctype.neededCores <= _resource.nbCores ;
+  if(info.worker.gang)
+  {
+    if(_broker)
+      _broker->releaseGang(*info.worker.gang);
+    else
+      for(const RunInfo& worker : *info.worker.gang)
+        _resources.free(worker);
+    std::list<std::vector<RunInfo> >::iterator it = _runningGangs.begin();
+    while(&(*it) != info.worker.gang)
+      it++;
+    _runningGangs.erase(it);
+  }
+  else if(!info.worker.type->ignoreResources)
+  {
+    if(_broker)
+      _broker->release(info.worker);
+    else
+      _resources.free(info.worker);
+  }
 }
-                                          
-bool DefaultAlgorithm::ResourceLoadInfo::isAllocPossible
-                                (const ContainerType& ctype)const
+
+bool DefaultAlgorithm::isLocal(const WaitingTask& waitingTask,
+                               const Resource& resource)
 {
-  return ctype.neededCores + _load <= _resource.nbCores;
+  // the tasks without locality hints can run anywhere
+  if(waitingTask.locality.empty())
+    return true;
+  for(const std::pair<const Resource*, float>& preference
+                                                    : waitingTask.locality)
+    if(preference.first == &resource)
+      return true;
+  return false;
 }
 
-float DefaultAlgorithm::ResourceLoadInfo::cost
-                                (const ContainerType& ctype)const
+float DefaultAlgorithm::neededCores(const Task* t)
 {
-  return _loadCost * 100.0 / float(_resource.nbCores);
+  const ContainerType& ctype = t->type();
+  return ctype.neededCores * ctype.gangSize;
 }
 
-unsigned int DefaultAlgorithm::ResourceLoadInfo::alloc
-                                (const ContainerType& ctype)
+bool DefaultAlgorithm::allocGang(Task* t, ContainerTypeHandle typeHandle,
+                                 RunInfo& worker)
 {
-  std::list<ResourceInfoForContainer>::iterator it = std::find(_ctypes.begin(),
-                                                               _ctypes.end(),
-                                                               ctype);
-  // add the type if not found
-  if(it == _ctypes.end())
+  std::vector<RunInfo> workers;
+  bool found = false;
+  if(_broker)
+    found = _broker->leaseGang(t, typeHandle, workers);
+  else
+    found = _resources.allocGang(t, typeHandle, workers);
+  if(!found)
   {
-    _ctypes.emplace_back(_resource, ctype);
-    it = _ctypes.end();
-    it--;
+    // Without a reservation, the smaller tasks could use the resources
+    // forever.
+    if(_reservingTask == nullptr)
+    {
+      bool reserved = false;
+      if(_broker)
+        reserved = _broker->reserve(t, typeHandle);
+      else
+        reserved = _resources.reserve(t, typeHandle);
+      if(reserved)
+        _reservingTask = t;
+    }
+    return false;
   }
-  _load += ctype.neededCores;
-  if(ctype.neededCores == 0)
-    _loadCost += COST_FOR_0_CORE_TASKS;
-  else
-    _loadCost += ctype.neededCores;
-  return it->alloc();
+  if(_reservingTask == t)
+  {
+    if(_broker)
+      _broker->cancelReservation();
+    else
+      _resources.cancelReservation();
+    _reservingTask = nullptr;
+  }
+  _runningGangs.push_back(std::move(workers));
+  std::vector<RunInfo>& gang = _runningGangs.back();
+  for(RunInfo& slot : gang)
+    slot.gang = &gang;
+  worker = gang.front();
+  return true;
+}
+
+const Resource* DefaultAlgorithm::findResource(const std::string& name)
+{
+  if(_broker)
+    return _broker->findResource(name);
+  return _resources.findResource(name);
 }
 
-void DefaultAlgorithm::ResourceLoadInfo::free
-                                (const ContainerType& ctype, int index)
+bool DefaultAlgorithm::allocLocal(WaitingTask& waitingTask, RunInfo& worker)
 {
-  _load -= ctype.neededCores;
-  if(ctype.neededCores == 0)
-    _loadCost -= COST_FOR_0_CORE_TASKS;
+  LocalityPlacement placement;
+  placement.preferences = &waitingTask.locality;
+  placement.transferCost = _transferCost;
+  // delay scheduling: wait for a while for a resource with the data
+  Clock::time_point now = Clock::now();
+  if(waitingTask.delayed)
+    placement.localOnly = now < waitingTask.delayStart + _localityDelay;
   else
-    _loadCost -= ctype.neededCores;
-  std::list<ResourceInfoForContainer>::iterator it = std::find(_ctypes.begin(),
-                                                               _ctypes.end(),
-                                                               ctype);
-  it->free(index);
+    placement.localOnly = _localityDelay.count() > 0;
+  bool result = false;
+  if(_broker)
+    result = _broker->lease(waitingTask.task, waitingTask.typeHandle, worker,
+                            placement);
+  else
+    result = _resources.alloc(waitingTask.task, waitingTask.typeHandle,
+                              worker, placement);
+  if(!result && placement.localOnly)
+  {
+    if(!waitingTask.delayed)
+    {
+      waitingTask.delayed = true;
+      waitingTask.delayStart = now;
+    }
+    // the task can go to another resource at the end of the delay
+    _retryTime = std::min(_retryTime, waitingTask.delayStart + _localityDelay);
+  }
+  return result;
 }
 
 }
@@ -20,9 +20,11 @@
 #define ALGORITHMIMPLEMENT_H
 
 #include "WorkloadAlgorithm.hxx"
-#include <set>
-#include <map>
+#include "ResourcePool.hxx"
+#include "ResourceBroker.hxx"
 #include <list>
+#include <map>
+#include <chrono>
 
 namespace WorkloadManager
 {
@@ -32,60 +34,72 @@ namespace WorkloadManager
 class DefaultAlgorithm : public WorkloadAlgorithm
 {
 public:
+  DefaultAlgorithm();
+  // The resources are shared with the other users of the broker.
+  DefaultAlgorithm(ResourceBroker& broker);
+  ~DefaultAlgorithm();
   void addTask(Task* t)override;
   void addResource(const Resource& r)override;
+  ContainerTypeHandle registerType(const ContainerType& ctype)override;
   LaunchInfo chooseTask()override;
   void liberate(const LaunchInfo& info)override;
   bool empty()const override;
+  Task* chooseBatchedTask(const LaunchInfo& launched)override;
+  Task* removeTask(const std::function<bool(Task*)>& accept)override;
+  void setResourceListener(const std::function<void()>& listener)override;
+  void setDataSetLocation(const std::string& dataSet,
+                          const std::string& resourceName)override;
+  std::chrono::steady_clock::time_point retryTime()const override;
+
+  // Data locality (see Task::localityHints). The cost of the transfer of a
+  // weight of 1 is compared to the relative load of the resources in %.
+  // Default is 100.
+  // Once the manager is started, use WorkloadManager::setTransferCost and
+  // setLocalityDelay, which take its lock.
+  void setTransferCost(float cost)override;
+  // A task with locality hints waits at most delay for a free container on
+  // a resource where its data is, before going to another resource.
+  // Default is 0.
+  void setLocalityDelay(const std::chrono::milliseconds& delay)override;
+  // Placement of the tasks without gang or locality. Once the manager is
+  // started, use WorkloadManager::setPlacementMode, which takes its lock.
+  void setPlacementMode(PlacementMode mode)override;
+  // Pin the containers of the resource to CPUs (see ResourcePool).
+  // The resource must be added before and it must have no running
+  // container. Once the manager is started, use
+  // WorkloadManager::setCpuTopology, which takes its lock.
+  bool setCpuTopology(const std::string& resourceName,
+                      const CpuTopology& topology)override;
 
-// ----------------------------- PRIVATE ----------------------------- //
 private:
-  class ResourceInfoForContainer
-  {
-  public:
-    ResourceInfoForContainer(const Resource& r, const ContainerType& ctype);
-    unsigned int maxContainers()const;
-    unsigned int  alloc();
-    void free(unsigned int index);
-    unsigned int nbRunningContainers()const;
-    bool isContainerRunning(unsigned int index)const;
-    bool operator<(const ResourceInfoForContainer& other)const
-    { return _ctype < other._ctype;}
-    bool operator==(const ContainerType& other)const
-    { return _ctype == other;}
-    const ContainerType& type()const { return _ctype;}
-  private:
-    ContainerType _ctype;
-    const Resource& _resource; // same ref as ResourceLoadInfo
-    std::set<unsigned int> _runningContainers; // 0 to max possible containers on this resource
-    unsigned int _firstFreeContainer;
-  };
-  
-  class ResourceLoadInfo
+  typedef std::chrono::steady_clock Clock;
+  struct WaitingTask
   {
-  public:
-    ResourceLoadInfo(const Resource& r);
-    bool isSupported(const ContainerType& ctype)const;
-    bool isAllocPossible(const ContainerType& ctype)const;
-    float cost(const ContainerType& ctype)const;
-    unsigned int alloc(const ContainerType& ctype);
-    void free(const ContainerType& ctype, int index);
-    bool operator<(const ResourceLoadInfo& other)const
-    { return _resource < other._resource;}
-    bool operator==(const Resource& other)const
-    { return _resource == other;}
-    const Resource& resource()const { return _resource;}
-    float COST_FOR_0_CORE_TASKS = 1.0 / 4096.0 ;
-  private:
-    Resource _resource;
-    float _load;
-    float _loadCost;
-    std::list<ResourceInfoForContainer> _ctypes;
+    Task* task;
+    ContainerTypeHandle typeHandle;
+    LocalityPlacement::Preferences locality; // resources with data
+    Clock::time_point delayStart; // first time it waits for a local resource
+    bool delayed = false;
   };
-  
-private:
-  std::list<ResourceLoadInfo> _resources;
-  std::list<Task*> _waitingTasks;
+
+  static float neededCores(const Task* t);
+  static bool isLocal(const WaitingTask& waitingTask,
+                      const Resource& resource);
+  bool allocGang(Task* t, ContainerTypeHandle typeHandle, RunInfo& worker);
+  bool allocLocal(WaitingTask& waitingTask, RunInfo& worker);
+  const Resource* findResource(const std::string& name);
+
+  ResourcePool _resources;
+  ResourceBroker* _broker; // nullptr if the resources are not shared
+  int _listenerId;
+  std::list<WaitingTask> _waitingTasks;
+  std::list<std::vector<RunInfo> > _runningGangs;
+  Task* _reservingTask; // gang task for which resources are reserved
+  std::multimap<std::string, std::string> _dataSets; // data set -> resource
+  float _transferCost;
+  Clock::duration _localityDelay;
+  Clock::time_point _retryTime;
+  PlacementMode _placementMode;
 };
 }
 #endif // ALGORITHMIMPLEMENT_H
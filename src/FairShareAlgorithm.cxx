@@ -0,0 +1,234 @@
+// Copyright (C) 2020  CEA/DEN, EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+#include "FairShareAlgorithm.hxx"
+#include <algorithm>
+
+namespace WorkloadManager
+{
+constexpr double FairShareAlgorithm::COST_FOR_0_CORE_TASKS;
+constexpr double FairShareAlgorithm::DEFAULT_TASK_DURATION;
+
+FairShareAlgorithm::FairShareAlgorithm()
+: _resources()
+, _groups()
+, _activeGroups()
+, _runningTasks()
+, _virtualTime(0.0)
+, _waitingCores()
+, _nbIgnoringTasks(0)
+, _slotStates()
+{
+}
+
+bool FairShareAlgorithm::setGroupWeight(int groupId, float weight)
+{
+  // the usage is divided by the weight (NaN is rejected too)
+  if(!(weight > 0.0))
+    return false;
+  Group& group = _groups[groupId];
+  group.weight = weight;
+  return true;
+}
+
+void FairShareAlgorithm::addTask(Task* t)
+{
+  int groupId = t->group();
+  Group& group = _groups[groupId];
+  if(group.waitingTasks.empty())
+  {
+    // A group which comes back does not get credit for its idle time.
+    group.virtualTime = std::max(group.virtualTime, _virtualTime);
+    _activeGroups.emplace(group.virtualTime, groupId);
+  }
+  WaitingTask newTask;
+  newTask.task = t;
+  newTask.typeHandle = _resources.registerType(t->type());
+  if(t->type().ignoreResources)
+    _nbIgnoringTasks++;
+  else
+    _waitingCores.insert(t->type().neededCores);
+  if(isSpecial(t))
+    group.nbSpecialTasks++;
+  // put the tasks which need more cores in front.
+  std::list<WaitingTask>& waitingTasks = group.waitingTasks;
+  float newNeedCores = neededCores(t);
+  if(waitingTasks.empty())
+    waitingTasks.push_back(newTask);
+  else if(neededCores(waitingTasks.back().task) >= newNeedCores)
+    waitingTasks.push_back(newTask);
+  else
+  {
+    std::list<WaitingTask>::iterator it = waitingTasks.begin();
+    while(it != waitingTasks.end()
+          && neededCores(it->task) >= newNeedCores)
+      it++;
+    waitingTasks.insert(it, newTask);
+  }
+}
+
+ContainerTypeHandle FairShareAlgorithm::registerType
+                                (const ContainerType& ctype)
+{
+  return _resources.registerType(ctype);
+}
+
+bool FairShareAlgorithm::empty()const
+{
+  return _activeGroups.empty();
+}
+
+void FairShareAlgorithm::addResource(const Resource& r)
+{
+  _resources.addResource(r);
+}
+
+WorkloadAlgorithm::LaunchInfo FairShareAlgorithm::chooseTask()
+{
+  LaunchInfo result;
+  if(_nbIgnoringTasks == 0
+     && (_waitingCores.empty()
+         || _resources.maxFreeCores() < *_waitingCores.begin()))
+    return result;
+  std::fill(_slotStates.begin(), _slotStates.end(), UNKNOWN_SLOT);
+  // Groups are visited by increasing virtual time. Usually, the first one
+  // can run a task and the choice is done in O(log(number of groups)).
+  ActiveGroups::iterator itGroup = _activeGroups.begin();
+  while(!result.taskFound && itGroup != _activeGroups.end())
+  {
+    int groupId = itGroup->second;
+    Group& group = _groups[groupId];
+    // the other tasks of the group need more cores than the last one
+    if(group.nbSpecialTasks == 0
+       && !hasFreeSlot(group.waitingTasks.back().typeHandle))
+    {
+      itGroup++;
+      continue;
+    }
+    std::list<WaitingTask>::iterator itTask = group.waitingTasks.begin();
+    while(!result.taskFound && itTask != group.waitingTasks.end())
+    {
+      const ContainerType& ctype = itTask->task->type();
+      if(ctype.ignoreResources)
+      {
+        result.taskFound = true;
+        result.worker.typeHandle = itTask->typeHandle;
+        result.worker.type = _resources.type(itTask->typeHandle);
+      }
+      // A gang task is tried even without a free slot, in order to reserve
+      // the resources.
+      else if(ctype.gangSize > 1)
+        result.taskFound = _resources.launchGang(itTask->task,
+                                                 itTask->typeHandle,
+                                                 result.worker);
+      else if(hasFreeSlot(itTask->typeHandle))
+        result.taskFound = _resources.alloc(itTask->task, itTask->typeHandle,
+                                            result.worker);
+      if(!result.taskFound)
+        itTask++;
+    }
+    if(result.taskFound)
+    {
+      result.task = itTask->task;
+      taskRemoved(group, result.task);
+      group.waitingTasks.erase(itTask);
+      _virtualTime = itGroup->first;
+      _activeGroups.erase(itGroup);
+      Launch launch;
+      launch.start = Clock::now();
+      launch.charged = chargedCores(*result.worker.type) * group.meanDuration;
+      _runningTasks.emplace(result.task, launch);
+      charge(groupId, group, launch.charged);
+    }
+    else
+      itGroup++;
+  }
+  return result;
+}
+
+void FairShareAlgorithm::liberate(const LaunchInfo& info)
+{
+  const ContainerType& ctype = *info.worker.type;
+  if(info.worker.gang)
+    _resources.freeGang(info.worker);
+  else if(!ctype.ignoreResources)
+    _resources.free(info.worker);
+
+  std::unordered_multimap<Task*, Launch>::iterator itLaunch;
+  itLaunch = _runningTasks.find(info.task); // we are sure to find it
+  std::chrono::duration<double> duration = Clock::now() - itLaunch->second.start;
+  double charged = itLaunch->second.charged;
+  _runningTasks.erase(itLaunch);
+
+  int groupId = info.task->group();
+  Group& group = _groups[groupId];
+  // exponential moving average of the observed durations
+  group.meanDuration = 0.8 * group.meanDuration + 0.2 * duration.count();
+  charge(groupId, group, chargedCores(ctype) * duration.count() - charged);
+}
+
+float FairShareAlgorithm::neededCores(const Task* t)
+{
+  const ContainerType& ctype = t->type();
+  return ctype.neededCores * ctype.gangSize;
+}
+
+bool FairShareAlgorithm::isSpecial(const Task* t)
+{
+  return t->type().ignoreResources || t->type().gangSize > 1;
+}
+
+void FairShareAlgorithm::taskRemoved(Group& group, const Task* t)
+{
+  if(t->type().ignoreResources)
+    _nbIgnoringTasks--;
+  else
+    _waitingCores.erase(_waitingCores.find(t->type().neededCores));
+  if(isSpecial(t))
+    group.nbSpecialTasks--;
+}
+
+bool FairShareAlgorithm::hasFreeSlot(ContainerTypeHandle typeHandle)
+{
+  if(typeHandle >= _slotStates.size())
+    _slotStates.resize(typeHandle + 1, UNKNOWN_SLOT);
+  SlotState& state = _slotStates[typeHandle];
+  if(state == UNKNOWN_SLOT)
+    state = _resources.hasFreeSlot(typeHandle) ? FREE_SLOT : NO_SLOT;
+  return state == FREE_SLOT;
+}
+
+double FairShareAlgorithm::chargedCores(const ContainerType& ctype)
+{
+  if(ctype.neededCores == 0)
+    return COST_FOR_0_CORE_TASKS * ctype.gangSize;
+  return ctype.neededCores * ctype.gangSize;
+}
+
+void FairShareAlgorithm::charge(int groupId, Group& group, double usage)
+{
+  // The group may be absent from the active groups when this is called.
+  bool isActive = !group.waitingTasks.empty();
+  if(isActive)
+    _activeGroups.erase(std::make_pair(group.virtualTime, groupId));
+  group.virtualTime += usage / group.weight;
+  if(isActive)
+    _activeGroups.emplace(group.virtualTime, groupId);
+}
+
+}
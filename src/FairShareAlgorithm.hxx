@@ -0,0 +1,111 @@
+// Copyright (C) 2020  CEA/DEN, EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+#ifndef FAIRSHAREALGORITHM_H
+#define FAIRSHAREALGORITHM_H
+
+#include "WorkloadAlgorithm.hxx"
+#include "ResourcePool.hxx"
+#include <list>
+#include <set>
+#include <vector>
+#include <unordered_map>
+#include <chrono>
+
+namespace WorkloadManager
+{
+/**
+ * Weighted fair-share scheduling between groups of tasks (see Task::group).
+ * Every group has its own waiting queue, ordered like in DefaultAlgorithm.
+ * The gang tasks are launched and reserve resources like in
+ * DefaultAlgorithm (see ResourcePool::launchGang).
+ * Groups are served by stride scheduling: the usage of a group, in
+ * core-seconds, is divided by its weight to obtain its virtual time and the
+ * active group with the lowest virtual time is served first.
+ * An estimation of the usage is charged when a task is launched and it is
+ * corrected with the real duration when the task is finished.
+ * The manager calls chooseTask until it finds nothing, so the last call
+ * must be cheap: it returns at once if no resource has enough free cores
+ * for the smallest waiting task, and it skips the types and the groups
+ * which cannot fit on the resources during the other calls.
+ */
+class FairShareAlgorithm : public WorkloadAlgorithm
+{
+public:
+  FairShareAlgorithm();
+  // Default weight is 1.0. The weight must be positive, otherwise it is
+  // ignored and false is returned.
+  bool setGroupWeight(int group, float weight);
+  void addTask(Task* t)override;
+  void addResource(const Resource& r)override;
+  ContainerTypeHandle registerType(const ContainerType& ctype)override;
+  LaunchInfo chooseTask()override;
+  void liberate(const LaunchInfo& info)override;
+  bool empty()const override;
+
+  // charged cores for tasks which need no core.
+  static constexpr double COST_FOR_0_CORE_TASKS = 1.0 / 4096.0;
+  // expected duration (s) of a task before any task of the group is finished.
+  static constexpr double DEFAULT_TASK_DURATION = 1.0;
+
+private:
+  typedef std::chrono::steady_clock Clock;
+  struct WaitingTask
+  {
+    Task* task;
+    ContainerTypeHandle typeHandle;
+  };
+  struct Group
+  {
+    double weight = 1.0;
+    double virtualTime = 0.0; // charged core-seconds / weight
+    double meanDuration = DEFAULT_TASK_DURATION;
+    std::list<WaitingTask> waitingTasks;
+    // Gang tasks and tasks which ignore the resources. Without them, the
+    // last task needs the fewest cores of the group.
+    unsigned int nbSpecialTasks = 0;
+  };
+  struct Launch
+  {
+    Clock::time_point start;
+    double charged; // core-seconds
+  };
+  typedef std::set<std::pair<double, int> > ActiveGroups; // (virtualTime, group)
+
+  static float neededCores(const Task* t);
+  static double chargedCores(const ContainerType& ctype);
+  void charge(int groupId, Group& group, double usage);
+  static bool isSpecial(const Task* t);
+  void taskRemoved(Group& group, const Task* t);
+  // false if no container of the type can be launched now, memorized for
+  // the current call of chooseTask.
+  bool hasFreeSlot(ContainerTypeHandle typeHandle);
+
+private:
+  ResourcePool _resources;
+  std::unordered_map<int, Group> _groups;
+  ActiveGroups _activeGroups; // groups with waiting tasks
+  std::unordered_multimap<Task*, Launch> _runningTasks;
+  double _virtualTime; // virtual time of the last served group
+  std::multiset<float> _waitingCores; // cores of a container, by task
+  std::size_t _nbIgnoringTasks; // waiting tasks which ignore the resources
+  enum SlotState : char { UNKNOWN_SLOT, FREE_SLOT, NO_SLOT };
+  std::vector<SlotState> _slotStates; // index is the type handle
+};
+}
+#endif // FAIRSHAREALGORITHM_H
@@ -0,0 +1,86 @@
+// Copyright (C) 2020  CEA/DEN, EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+#ifndef PLACEMENTPOLICIES_H
+#define PLACEMENTPOLICIES_H
+
+#include "Task.hxx"
+#include <vector>
+#include <utility>
+#include <limits>
+
+namespace WorkloadManager
+{
+/**
+ * Placement policies used by ResourcePool::alloc. The cost of a new container
+ * of type ctype is computed for every resource where it can be launched and
+ * the resource with the lowest cost is chosen.
+ * load is the number of cores used on the resource and loadCost is the same
+ * value where the containers which need no core count as a small fraction of
+ * a core.
+ * A resource with an infinite cost is never chosen.
+ */
+
+// Choose the less loaded resource (relative load).
+struct SpreadPlacement
+{
+  float cost(const Resource& r, float load, float loadCost,
+             const ContainerType& ctype)const
+  {
+    return loadCost * 100.0 / float(r.nbCores);
+  }
+};
+
+// Choose the resource with the least free cores left (best fit), in order to
+// keep whole resources free for bigger tasks. It has no cost: ResourcePool
+// finds the best fit in its index of the free cores (see allocBestFit).
+struct PackPlacement
+{
+};
+
+// Data locality: the cost of the transfer of the data which is not on the
+// resource is added to the relative load (SpreadPlacement).
+struct LocalityPlacement
+{
+  typedef std::vector<std::pair<const Resource*, float> > Preferences;
+  // resources where the data is and weight of the data
+  const Preferences* preferences = nullptr;
+  // cost of the transfer of a weight of 1, compared to a relative load in %
+  float transferCost = 100.0;
+  // if true, only the resources with data can be chosen
+  bool localOnly = false;
+
+  float cost(const Resource& r, float load, float loadCost,
+             const ContainerType& ctype)const
+  {
+    float totalWeight = 0.0;
+    float localWeight = 0.0;
+    for(const std::pair<const Resource*, float>& preference : *preferences)
+    {
+      totalWeight += preference.second;
+      if(preference.first == &r)
+        localWeight += preference.second;
+    }
+    if(localOnly && localWeight == 0.0)
+      return std::numeric_limits<float>::infinity();
+    return SpreadPlacement().cost(r, load, loadCost, ctype)
+           + transferCost * (totalWeight - localWeight);
+  }
+};
+}
+#endif // PLACEMENTPOLICIES_H
@@ -0,0 +1,215 @@
+// Copyright (C) 2020  CEA/DEN, EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+#ifndef POLICYALGORITHM_H
+#define POLICYALGORITHM_H
+
+#include "WorkloadAlgorithm.hxx"
+#include "ResourcePool.hxx"
+#include "PlacementPolicies.hxx"
+#include <list>
+
+namespace WorkloadManager
+{
+/**
+ * Ordering policies of the waiting tasks. before(a, b) is true if the task a
+ * should be chosen before the task b. Tasks which are not ordered by the
+ * policy are chosen in the order they were added.
+ */
+
+// The tasks which need more cores are chosen first (as in DefaultAlgorithm).
+// The cores of a gang task are the cores of all its containers.
+struct CoresFirstOrdering
+{
+  bool before(const Task& a, const Task& b)const
+  {
+    return a.type().neededCores * a.type().gangSize
+           > b.type().neededCores * b.type().gangSize;
+  }
+};
+
+// The tasks are chosen in the order they were added.
+struct FifoOrdering
+{
+  bool before(const Task& a, const Task& b)const
+  {
+    return false;
+  }
+};
+
+/**
+ * Slot allocation policies. alloc allocates a container for a task which
+ * needs one container, on a resource chosen with the placement policy (see
+ * ResourcePool::alloc). The gang tasks and the tasks which ignore the
+ * resources are not given to the slot allocation policy.
+ */
+
+// Any resource where the container fits can be chosen.
+struct SharedSlots
+{
+  template <class Placement>
+  bool alloc(ResourcePool& resources, Task* t, ContainerTypeHandle typeHandle,
+             RunInfo& worker, const Placement& placement)const
+  {
+    return resources.alloc(t, typeHandle, worker, placement);
+  }
+};
+
+// Data affinity: a task is launched on a resource named in its locality
+// hints if one has a free slot (see LocalityPlacement), otherwise where the
+// placement policy chooses. The data sets of the hints are ignored.
+struct AffinitySlots
+{
+  template <class Placement>
+  bool alloc(ResourcePool& resources, Task* t, ContainerTypeHandle typeHandle,
+             RunInfo& worker, const Placement& placement)const
+  {
+    LocalityPlacement::Preferences preferences;
+    for(const LocalityHint& hint : t->localityHints())
+    {
+      const Resource* r = resources.findResource(hint.resourceName);
+      if(r)
+        preferences.emplace_back(r, hint.weight);
+    }
+    if(!preferences.empty())
+    {
+      LocalityPlacement local;
+      local.preferences = &preferences;
+      local.localOnly = true;
+      if(resources.alloc(t, typeHandle, worker, local))
+        return true;
+    }
+    return resources.alloc(t, typeHandle, worker, placement);
+  }
+};
+
+/**
+ * Algorithm built on compile time policies. The ordering policy sorts the
+ * waiting tasks and the placement policy (see PlacementPolicies.hxx) chooses
+ * the resource of a task, which gets a container with the slot allocation
+ * policy. The gang tasks are launched and reserve resources like in
+ * DefaultAlgorithm, whatever the policies (see ResourcePool::launchGang).
+ * The policies are inlined in the loops of addTask and chooseTask. The class
+ * is final, so a manager instantiated on it (see BasicWorkloadManager) calls
+ * the algorithm without the virtual WorkloadAlgorithm interface.
+ */
+template <class Ordering, class Placement, class Slots = SharedSlots>
+class PolicyAlgorithm final : public WorkloadAlgorithm
+{
+public:
+  PolicyAlgorithm(const Ordering& ordering = Ordering(),
+                  const Placement& placement = Placement(),
+                  const Slots& slots = Slots())
+  : _ordering(ordering)
+  , _placement(placement)
+  , _slots(slots)
+  , _resources()
+  , _waitingTasks()
+  {
+  }
+
+  void addTask(Task* t)override
+  {
+    WaitingTask newTask;
+    newTask.task = t;
+    newTask.typeHandle = _resources.registerType(t->type());
+    if(_waitingTasks.empty()
+       || !_ordering.before(*t, *_waitingTasks.back().task))
+      _waitingTasks.push_back(newTask);
+    else
+    {
+      typename std::list<WaitingTask>::iterator it = _waitingTasks.begin();
+      while(it != _waitingTasks.end() && !_ordering.before(*t, *it->task))
+        it++;
+      _waitingTasks.insert(it, newTask);
+    }
+  }
+
+  void addResource(const Resource& r)override
+  {
+    _resources.addResource(r);
+  }
+
+  ContainerTypeHandle registerType(const ContainerType& ctype)override
+  {
+    return _resources.registerType(ctype);
+  }
+
+  LaunchInfo chooseTask()override
+  {
+    LaunchInfo result;
+    typename std::list<WaitingTask>::iterator itTask = _waitingTasks.begin();
+    while(!result.taskFound && itTask != _waitingTasks.end())
+    {
+      Task* task = itTask->task;
+      if(task->type().ignoreResources)
+      {
+        result.taskFound = true;
+        result.worker.typeHandle = itTask->typeHandle;
+        result.worker.type = _resources.type(itTask->typeHandle);
+      }
+      else if(task->type().gangSize > 1)
+        result.taskFound = _resources.launchGang(task, itTask->typeHandle,
+                                                 result.worker);
+      else
+        result.taskFound = _slots.alloc(_resources, task, itTask->typeHandle,
+                                        result.worker, _placement);
+      if(result.taskFound)
+      {
+        result.task = task;
+        _waitingTasks.erase(itTask);
+      }
+      else
+        itTask++;
+    }
+    return result;
+  }
+
+  void liberate(const LaunchInfo& info)override
+  {
+    if(info.worker.gang)
+      _resources.freeGang(info.worker);
+    else if(!info.worker.type->ignoreResources)
+      _resources.free(info.worker);
+  }
+
+  bool empty()const override
+  {
+    return _waitingTasks.empty();
+  }
+
+private:
+  struct WaitingTask
+  {
+    Task* task;
+    ContainerTypeHandle typeHandle;
+  };
+
+  Ordering _ordering;
+  Placement _placement;
+  Slots _slots;
+  ResourcePool _resources;
+  std::list<WaitingTask> _waitingTasks;
+};
+
+typedef PolicyAlgorithm<CoresFirstOrdering, SpreadPlacement> SpreadAlgorithm;
+typedef PolicyAlgorithm<CoresFirstOrdering, PackPlacement> PackAlgorithm;
+typedef PolicyAlgorithm<CoresFirstOrdering, SpreadPlacement, AffinitySlots>
+        AffinityAlgorithm;
+}
+#endif // POLICYALGORITHM_H
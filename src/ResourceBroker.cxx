@@ -0,0 +1,167 @@
+// Copyright (C) 2020  CEA/DEN, EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+#include "ResourceBroker.hxx"
+
+namespace WorkloadManager
+{
+ResourceBroker::ResourceBroker()
+: _resources()
+, _mutex()
+, _releaseCondition()
+, _released(false)
+, _stop(false)
+, _listenersMutex()
+, _listeners()
+, _nextListenerId(0)
+, _notifier()
+{
+  _notifier = std::thread([this]
+    {
+      notifyListeners();
+    });
+}
+
+ResourceBroker::~ResourceBroker()
+{
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _stop = true;
+  }
+  _releaseCondition.notify_one();
+  _notifier.join();
+}
+
+void ResourceBroker::addResource(const Resource& r)
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  if(!_resources.hasResource(r))
+    _resources.addResource(r);
+}
+
+ContainerTypeHandle ResourceBroker::registerType(const ContainerType& ctype)
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  return _resources.registerType(ctype);
+}
+
+const ContainerType* ResourceBroker::type(ContainerTypeHandle handle)
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  return _resources.type(handle);
+}
+
+const Resource* ResourceBroker::findResource(const std::string& name)
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  return _resources.findResource(name);
+}
+
+bool ResourceBroker::lease(Task* t, ContainerTypeHandle typeHandle,
+                           RunInfo& worker)
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  return _resources.alloc(t, typeHandle, worker);
+}
+
+void ResourceBroker::release(const RunInfo& worker)
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  _resources.free(worker);
+  _released = true;
+  _releaseCondition.notify_one();
+}
+
+bool ResourceBroker::leaseBestFit(Task* t, ContainerTypeHandle typeHandle,
+                                  RunInfo& worker)
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  return _resources.allocBestFit(t, typeHandle, worker);
+}
+
+bool ResourceBroker::leaseGang(Task* t, ContainerTypeHandle typeHandle,
+                               std::vector<RunInfo>& workers)
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  return _resources.allocGang(t, typeHandle, workers);
+}
+
+void ResourceBroker::releaseGang(const std::vector<RunInfo>& workers)
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  for(const RunInfo& worker : workers)
+    _resources.free(worker);
+  _released = true;
+  _releaseCondition.notify_one();
+}
+
+bool ResourceBroker::reserve(Task* t, ContainerTypeHandle typeHandle)
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  return _resources.reserve(t, typeHandle);
+}
+
+void ResourceBroker::cancelReservation()
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  _resources.cancelReservation();
+}
+
+bool ResourceBroker::setCpuTopology(const std::string& resourceName,
+                                    const CpuTopology& topology)
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  return _resources.setCpuTopology(resourceName, topology);
+}
+
+int ResourceBroker::addListener(const Listener& listener)
+{
+  std::unique_lock<std::mutex> lock(_listenersMutex);
+  int id = _nextListenerId;
+  _nextListenerId++;
+  _listeners.emplace(id, listener);
+  return id;
+}
+
+void ResourceBroker::removeListener(int id)
+{
+  // Wait for the end of the notifications in progress.
+  std::unique_lock<std::mutex> lock(_listenersMutex);
+  _listeners.erase(id);
+}
+
+void ResourceBroker::notifyListeners()
+{
+  bool threadStop = false;
+  while(!threadStop)
+  {
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _releaseCondition.wait(lock, [this] {return _released || _stop;});
+      _released = false;
+      threadStop = _stop;
+    }
+    // The resource mutex is not held here, because the listeners take the
+    // locks of their managers, which are held when the broker is called.
+    std::unique_lock<std::mutex> lock(_listenersMutex);
+    for(const std::pair<const int, Listener>& listener : _listeners)
+      listener.second();
+  }
+}
+
+}
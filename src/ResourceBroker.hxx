@@ -0,0 +1,91 @@
+// Copyright (C) 2020  CEA/DEN, EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+#ifndef RESOURCEBROKER_H
+#define RESOURCEBROKER_H
+
+#include "ResourcePool.hxx"
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <thread>
+#include <map>
+
+namespace WorkloadManager
+{
+/**
+ * Resources shared by several algorithms (and so several WorkloadManager)
+ * in the same process. Every algorithm leases containers from the broker
+ * which keeps the global view of the load of the resources.
+ * When a container is released, the other users of the broker are notified
+ * from a dedicated thread, because they may be waiting for free resources.
+ */
+class ResourceBroker
+{
+public:
+  ResourceBroker();
+  ResourceBroker(const ResourceBroker&) = delete;
+  ~ResourceBroker();
+  // A resource already known by the broker is ignored.
+  void addResource(const Resource& r);
+  // see ResourcePool
+  ContainerTypeHandle registerType(const ContainerType& ctype);
+  const ContainerType* type(ContainerTypeHandle handle);
+  const Resource* findResource(const std::string& name);
+  // Choose the best resource for the task and allocate a container on it.
+  // Return false if no resource can run the task now.
+  bool lease(Task* t, ContainerTypeHandle typeHandle, RunInfo& worker);
+  template <class Placement>
+  bool lease(Task* t, ContainerTypeHandle typeHandle, RunInfo& worker,
+             const Placement& placement)
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _resources.alloc(t, typeHandle, worker, placement);
+  }
+  void release(const RunInfo& worker);
+  // see ResourcePool
+  bool leaseBestFit(Task* t, ContainerTypeHandle typeHandle, RunInfo& worker);
+  bool leaseGang(Task* t, ContainerTypeHandle typeHandle,
+                 std::vector<RunInfo>& workers);
+  void releaseGang(const std::vector<RunInfo>& workers);
+  bool reserve(Task* t, ContainerTypeHandle typeHandle);
+  void cancelReservation();
+  bool setCpuTopology(const std::string& resourceName,
+                      const CpuTopology& topology);
+
+  typedef std::function<void()> Listener;
+  // The listener is called when a container is released.
+  int addListener(const Listener& listener);
+  void removeListener(int id);
+
+private:
+  void notifyListeners();
+
+private:
+  ResourcePool _resources;
+  std::mutex _mutex; // protects the resources
+  std::condition_variable _releaseCondition;
+  bool _released;
+  bool _stop;
+  std::mutex _listenersMutex; // held while listeners are called
+  std::map<int, Listener> _listeners;
+  int _nextListenerId;
+  std::thread _notifier;
+};
+}
+#endif // RESOURCEBROKER_H
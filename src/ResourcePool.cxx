@@ -0,0 +1,461 @@
+// Copyright (C) 2020  CEA/DEN, EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+#include "ResourcePool.hxx"
+#include <algorithm>
+#include <cmath>
+
+namespace WorkloadManager
+{
+constexpr std::size_t ResourcePool::MAX_CACHED_TYPES;
+
+ResourcePool::ResourcePool()
+: _resources()
+, _types()
+, _typeHandles()
+, _typeCache()
+, _freeCoresIndex()
+, _reservingTask(nullptr)
+, _runningGangs()
+{
+}
+
+void ResourcePool::addResource(const Resource& r)
+{
+  _freeCoresIndex.emplace(float(r.nbCores), _resources.size());
+  _resources.emplace_back(r);
+}
+
+bool ResourcePool::hasResource(const Resource& r)const
+{
+  return std::find(_resources.begin(), _resources.end(), r) != _resources.end();
+}
+
+const Resource* ResourcePool::findResource(const std::string& name)const
+{
+  for(const ResourceLoadInfo& resource : _resources)
+    if(resource.resource().name == name)
+      return &resource.resource();
+  return nullptr;
+}
+
+ContainerTypeHandle ResourcePool::registerType(const ContainerType& ctype)
+{
+  // The object may be a new type at the address of a destroyed one.
+  auto cached = _typeCache.find(&ctype);
+  if(cached != _typeCache.end() && _types[cached->second] == ctype)
+    return cached->second;
+  ContainerTypeHandle result;
+  std::map<ContainerType, ContainerTypeHandle>::iterator it;
+  it = _typeHandles.find(ctype);
+  if(it != _typeHandles.end())
+    result = it->second;
+  else
+  {
+    result = _types.size();
+    _types.push_back(ctype);
+    _typeHandles.emplace(ctype, result);
+  }
+  // bounded if every task has its own type object
+  if(_typeCache.size() >= MAX_CACHED_TYPES)
+    _typeCache.clear();
+  _typeCache[&ctype] = result;
+  return result;
+}
+
+const ContainerType* ResourcePool::type(ContainerTypeHandle handle)const
+{
+  return &_types[handle];
+}
+
+bool ResourcePool::alloc(Task* t, ContainerTypeHandle typeHandle,
+                         RunInfo& worker)
+{
+  return alloc(t, typeHandle, worker, SpreadPlacement());
+}
+
+void ResourcePool::free(const RunInfo& worker)
+{
+  ResourceLoadInfo& resource = _resources[worker.resourceHandle];
+  _freeCoresIndex.erase(std::make_pair(resource.freeCores(),
+                                       worker.resourceHandle));
+  resource.free(*worker.type, worker.typeHandle, worker.index);
+  _freeCoresIndex.emplace(resource.freeCores(), worker.resourceHandle);
+}
+
+float ResourcePool::maxFreeCores()const
+{
+  if(_freeCoresIndex.empty())
+    return -1.0;
+  return _freeCoresIndex.rbegin()->first;
+}
+
+bool ResourcePool::hasFreeSlot(ContainerTypeHandle typeHandle)const
+{
+  const ContainerType& ctype = _types[typeHandle];
+  std::set<std::pair<float, ResourceHandle> >::const_iterator it;
+  it = _freeCoresIndex.lower_bound(std::make_pair(ctype.neededCores,
+                                                  ResourceHandle(0)));
+  for(; it != _freeCoresIndex.end(); it++)
+    if(!_resources[it->second].isReserved())
+      return true;
+  return false;
+}
+
+bool ResourcePool::allocBestFit(Task* t, ContainerTypeHandle typeHandle,
+                                RunInfo& worker)
+{
+  const ContainerType& ctype = _types[typeHandle];
+  // The first resources have just enough free cores.
+  std::set<std::pair<float, ResourceHandle> >::iterator it;
+  it = _freeCoresIndex.lower_bound(std::make_pair(ctype.neededCores,
+                                                  ResourceHandle(0)));
+  while(it != _freeCoresIndex.end())
+  {
+    const ResourceLoadInfo& resource = _resources[it->second];
+    if(!resource.isReserved() && t->isAccepted(resource.resource()))
+    {
+      allocOn(it->second, typeHandle, worker);
+      return true;
+    }
+    it++;
+  }
+  return false;
+}
+
+void ResourcePool::allocOn(ResourceHandle handle,
+                           ContainerTypeHandle typeHandle,
+                           RunInfo& worker)
+{
+  const ContainerType& ctype = _types[typeHandle];
+  ResourceLoadInfo& resource = _resources[handle];
+  _freeCoresIndex.erase(std::make_pair(resource.freeCores(), handle));
+  worker.type = &ctype;
+  worker.typeHandle = typeHandle;
+  worker.resource = &resource.resource();
+  worker.resourceHandle = handle;
+  worker.index = resource.alloc(ctype, typeHandle);
+  worker.gang = nullptr;
+  worker.cpus = resource.cpus(ctype, typeHandle, worker.index);
+  _freeCoresIndex.emplace(resource.freeCores(), handle);
+}
+
+bool ResourcePool::allocGang(Task* t, ContainerTypeHandle typeHandle,
+                             std::vector<RunInfo>& workers)
+{
+  unsigned int gangSize = _types[typeHandle].gangSize;
+  workers.resize(gangSize);
+  unsigned int nbAllocated = 0;
+  while(nbAllocated < gangSize
+        && allocSlot(t, typeHandle, workers[nbAllocated], SpreadPlacement(),
+                     t == _reservingTask))
+    nbAllocated++;
+  if(nbAllocated == gangSize)
+    return true;
+  // all or nothing
+  for(unsigned int i = 0; i < nbAllocated; i++)
+    free(workers[i]);
+  workers.clear();
+  return false;
+}
+
+bool ResourcePool::reserve(Task* t, ContainerTypeHandle typeHandle)
+{
+  if(_reservingTask)
+    return false;
+  const ContainerType& ctype = _types[typeHandle];
+  // Reserve the biggest resources first, in order to block as few
+  // resources as possible.
+  std::vector<ResourceLoadInfo*> candidates;
+  for(ResourceLoadInfo& resource : _resources)
+    if(resource.isSupported(ctype) && t->isAccepted(resource.resource()))
+      candidates.push_back(&resource);
+  std::sort(candidates.begin(), candidates.end(),
+            [](const ResourceLoadInfo* a, const ResourceLoadInfo* b)
+            {
+              return a->resource().nbCores > b->resource().nbCores;
+            });
+  unsigned int nbSlots = 0;
+  std::vector<ResourceLoadInfo*>::iterator it = candidates.begin();
+  while(nbSlots < ctype.gangSize && it != candidates.end())
+  {
+    if(ctype.neededCores == 0)
+      nbSlots = ctype.gangSize;
+    else
+      nbSlots += (*it)->resource().nbCores / ctype.neededCores;
+    it++;
+  }
+  if(nbSlots < ctype.gangSize)
+    return false;
+  candidates.erase(it, candidates.end());
+  for(ResourceLoadInfo* resource : candidates)
+    resource->setReserved(true);
+  _reservingTask = t;
+  return true;
+}
+
+void ResourcePool::cancelReservation()
+{
+  for(ResourceLoadInfo& resource : _resources)
+    resource.setReserved(false);
+  _reservingTask = nullptr;
+}
+
+bool ResourcePool::launchGang(Task* t, ContainerTypeHandle typeHandle,
+                              RunInfo& worker)
+{
+  std::vector<RunInfo> workers;
+  if(!allocGang(t, typeHandle, workers))
+  {
+    // Without a reservation, the smaller tasks could use the resources
+    // forever.
+    if(_reservingTask == nullptr)
+      reserve(t, typeHandle);
+    return false;
+  }
+  if(_reservingTask == t)
+    cancelReservation();
+  _runningGangs.push_back(std::move(workers));
+  std::vector<RunInfo>& gang = _runningGangs.back();
+  for(RunInfo& slot : gang)
+    slot.gang = &gang;
+  worker = gang.front();
+  return true;
+}
+
+void ResourcePool::freeGang(const RunInfo& worker)
+{
+  for(const RunInfo& slot : *worker.gang)
+    free(slot);
+  std::list<std::vector<RunInfo> >::iterator it = _runningGangs.begin();
+  while(&(*it) != worker.gang)
+    it++;
+  _runningGangs.erase(it);
+}
+
+bool ResourcePool::setCpuTopology(const std::string& resourceName,
+                                  const CpuTopology& topology)
+{
+  for(ResourceLoadInfo& resource : _resources)
+    if(resource.resource().name == resourceName)
+      return resource.setCpuTopology(topology);
+  return false;
+}
+
+// ResourceInfoForContainer
+
+ResourcePool::ResourceInfoForContainer::ResourceInfoForContainer()
+: _runningContainers()
+, _nbRunningContainers(0)
+, _firstFreeContainer(0)
+, _cpus()
+{
+}
+
+unsigned int  ResourcePool::ResourceInfoForContainer::alloc()
+{
+  unsigned int result = _firstFreeContainer;
+  if(result >= _runningContainers.size())
+    _runningContainers.resize(result + 1, false);
+  _runningContainers[result] = true;
+  _nbRunningContainers++;
+  _firstFreeContainer++;
+  while(isContainerRunning(_firstFreeContainer))
+    _firstFreeContainer++;
+  return result;
+}
+
+void ResourcePool::ResourceInfoForContainer::free(unsigned int index)
+{
+  _runningContainers[index] = false;
+  _nbRunningContainers--;
+  if(index < _firstFreeContainer)
+    _firstFreeContainer = index;
+}
+
+unsigned int ResourcePool::ResourceInfoForContainer::nbRunningContainers()const
+{
+  return _nbRunningContainers;
+}
+
+bool ResourcePool::ResourceInfoForContainer::isContainerRunning
+                                (unsigned int index)const
+{
+  return index < _runningContainers.size() && _runningContainers[index];
+}
+
+CpuTopology::CpuList& ResourcePool::ResourceInfoForContainer::cpus
+                                (unsigned int index)
+{
+  if(index >= _cpus.size())
+    _cpus.resize(index + 1);
+  return _cpus[index];
+}
+
+// ResourceLoadInfo
+
+ResourcePool::ResourceLoadInfo::ResourceLoadInfo(const Resource& r)
+: _resource(r)
+, _load(0.0)
+, _loadCost(0.0)
+, _reserved(false)
+, _ctypes()
+, _topology()
+, _cpuUsers()
+{
+}
+
+bool ResourcePool::ResourceLoadInfo::isSupported
+                                (const ContainerType& ctype)const
+{
+  return ctype.neededCores <= _resource.nbCores ;
+}
+                                          
+bool ResourcePool::ResourceLoadInfo::isAllocPossible
+                                (const ContainerType& ctype)const
+{
+  return ctype.neededCores + _load <= _resource.nbCores;
+}
+
+unsigned int ResourcePool::ResourceLoadInfo::alloc
+                                (const ContainerType& ctype,
+                                 ContainerTypeHandle handle)
+{
+  // add the type if not found
+  if(handle >= _ctypes.size())
+    _ctypes.resize(handle + 1);
+  _load += ctype.neededCores;
+  if(ctype.neededCores == 0)
+    _loadCost += COST_FOR_0_CORE_TASKS;
+  else
+    _loadCost += ctype.neededCores;
+  unsigned int index = _ctypes[handle].alloc();
+  if(isPinned(ctype))
+    pin(ctype, _ctypes[handle].cpus(index));
+  return index;
+}
+
+void ResourcePool::ResourceLoadInfo::free
+                                (const ContainerType& ctype,
+                                 ContainerTypeHandle handle,
+                                 int index)
+{
+  _load -= ctype.neededCores;
+  if(ctype.neededCores == 0)
+    _loadCost -= COST_FOR_0_CORE_TASKS;
+  else
+    _loadCost -= ctype.neededCores;
+  _ctypes[handle].free(index);
+  if(isPinned(ctype))
+    unpin(_ctypes[handle].cpus(index));
+}
+
+bool ResourcePool::ResourceLoadInfo::setCpuTopology
+                                (const CpuTopology& topology)
+{
+  // The CPUs of the running containers are counted in _cpuUsers.
+  for(const ResourceInfoForContainer& ctype : _ctypes)
+    if(ctype.nbRunningContainers() > 0)
+      return false;
+  // The CPUs kept for the next runs are not in the new topology.
+  for(ResourceInfoForContainer& ctype : _ctypes)
+    ctype.clearCpus();
+  _topology = topology;
+  _cpuUsers.assign(topology.cpusRange(), 0);
+  return true;
+}
+
+const CpuTopology::CpuList* ResourcePool::ResourceLoadInfo::cpus
+                                (const ContainerType& ctype,
+                                 ContainerTypeHandle handle,
+                                 unsigned int index)
+{
+  if(!isPinned(ctype))
+    return nullptr;
+  return &_ctypes[handle].cpus(index);
+}
+
+bool ResourcePool::ResourceLoadInfo::isPinned
+                                (const ContainerType& ctype)const
+{
+  // the containers without cores share the CPUs
+  return !_topology.empty() && ctype.neededCores > 0;
+}
+
+void ResourcePool::ResourceLoadInfo::pin(const ContainerType& ctype,
+                                         CpuTopology::CpuList& cpus)
+{
+  std::size_t nbCpus = std::ceil(ctype.neededCores);
+  // Keep the CPUs of the last run of this container, for the caches.
+  bool reuse = cpus.size() == nbCpus;
+  for(int cpu : cpus)
+    if(_cpuUsers[cpu] > 0)
+      reuse = false;
+  if(!reuse)
+  {
+    cpus.clear();
+    // Best fit: the node with the fewest free CPUs, if they are enough.
+    const CpuTopology::CpuList* bestNode = nullptr;
+    std::size_t bestNbFree = 0;
+    for(const CpuTopology::CpuList& node : _topology.nodes())
+    {
+      std::size_t nbFree = std::count_if(node.begin(), node.end(),
+                                         [this](int cpu)
+                                         {
+                                           return _cpuUsers[cpu] == 0;
+                                         });
+      if(nbFree >= nbCpus && (bestNode == nullptr || nbFree < bestNbFree))
+      {
+        bestNode = &node;
+        bestNbFree = nbFree;
+      }
+    }
+    if(bestNode)
+    {
+      for(int cpu : *bestNode)
+        if(cpus.size() < nbCpus && _cpuUsers[cpu] == 0)
+          cpus.push_back(cpu);
+    }
+    else
+    {
+      // Not enough free CPUs in a node: the less used CPUs, in the order
+      // of the nodes.
+      CpuTopology::CpuList candidates;
+      for(const CpuTopology::CpuList& node : _topology.nodes())
+        candidates.insert(candidates.end(), node.begin(), node.end());
+      std::stable_sort(candidates.begin(), candidates.end(),
+                       [this](int a, int b)
+                       {
+                         return _cpuUsers[a] < _cpuUsers[b];
+                       });
+      if(candidates.size() > nbCpus)
+        candidates.resize(nbCpus);
+      cpus = candidates;
+    }
+  }
+  for(int cpu : cpus)
+    _cpuUsers[cpu]++;
+}
+
+void ResourcePool::ResourceLoadInfo::unpin(const CpuTopology::CpuList& cpus)
+{
+  for(int cpu : cpus)
+    _cpuUsers[cpu]--;
+}
+
+}
@@ -0,0 +1,235 @@
+// Copyright (C) 2020  CEA/DEN, EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+#ifndef RESOURCEPOOL_H
+#define RESOURCEPOOL_H
+
+#include "Task.hxx"
+#include "PlacementPolicies.hxx"
+#include "CpuTopology.hxx"
+#include <vector>
+#include <deque>
+#include <list>
+#include <map>
+#include <unordered_map>
+#include <set>
+#include <utility>
+#include <limits>
+
+namespace WorkloadManager
+{
+/**
+ * Load accounting of a set of resources. It keeps track of the containers
+ * running on every resource and chooses the resource where a new container
+ * should be launched. It is shared by the scheduling algorithms.
+ * Container types are registered once and then identified by a handle, so
+ * the launch of a task does not copy or compare any string.
+ */
+class ResourcePool
+{
+public:
+  ResourcePool();
+  void addResource(const Resource& r);
+  bool hasResource(const Resource& r)const;
+  // Registered resource with this name, nullptr if not found.
+  const Resource* findResource(const std::string& name)const;
+  // Return the handle of the type. The type is registered if it is new.
+  ContainerTypeHandle registerType(const ContainerType& ctype);
+  // Registered copy of the type.
+  const ContainerType* type(ContainerTypeHandle handle)const;
+  // Choose the best resource for the task and allocate a container on it.
+  // Return false if no resource can run the task now.
+  bool alloc(Task* t, ContainerTypeHandle typeHandle, RunInfo& worker);
+  // Same as above with a placement policy (see PlacementPolicies.hxx).
+  template <class Placement>
+  bool alloc(Task* t, ContainerTypeHandle typeHandle, RunInfo& worker,
+             const Placement& placement);
+  bool alloc(Task* t, ContainerTypeHandle typeHandle, RunInfo& worker,
+             const PackPlacement& placement)
+  {
+    return allocBestFit(t, typeHandle, worker);
+  }
+  void free(const RunInfo& worker);
+  // Most free cores on a resource, reserved or not. Negative without
+  // resources.
+  float maxFreeCores()const;
+  // A container of the type could be launched now on a resource which is
+  // not reserved, if the task accepts it. If it is false, alloc fails for
+  // every task of the type.
+  bool hasFreeSlot(ContainerTypeHandle typeHandle)const;
+  // Allocate a container on the resource with the least free cores left
+  // (best fit), using an index of the resources ordered by free cores.
+  bool allocBestFit(Task* t, ContainerTypeHandle typeHandle, RunInfo& worker);
+  // Allocate the ctype.gangSize containers of a gang task at the same time,
+  // possibly on several resources. Nothing is allocated if it is not
+  // possible now. The task which owns the reservation can use the reserved
+  // resources.
+  bool allocGang(Task* t, ContainerTypeHandle typeHandle,
+                 std::vector<RunInfo>& workers);
+  // Reserve enough resources for a gang task which cannot be launched now.
+  // No other container is launched on the reserved resources until the
+  // reservation is cancelled, so they will be free for the gang task.
+  // Only this task can use the reserved resources.
+  // Return false if there is already a reservation or if the gang task can
+  // never run on these resources.
+  bool reserve(Task* t, ContainerTypeHandle typeHandle);
+  void cancelReservation();
+  // Gang task of an algorithm without a broker: allocGang, or reserve the
+  // resources for the task if it cannot be launched now and there is no
+  // reservation. The containers are kept until freeGang and worker is the
+  // first one, with worker.gang set.
+  bool launchGang(Task* t, ContainerTypeHandle typeHandle, RunInfo& worker);
+  // Free all the containers of the gang of the worker (see launchGang).
+  void freeGang(const RunInfo& worker);
+  // Pin the containers launched on the resource to CPUs of the topology,
+  // in the same NUMA node when possible. It is only meaningful for the
+  // local machine. Return false if the resource is not found or if it has
+  // running containers.
+  bool setCpuTopology(const std::string& resourceName,
+                      const CpuTopology& topology);
+
+// ----------------------------- PRIVATE ----------------------------- //
+private:
+  class ResourceInfoForContainer
+  {
+  public:
+    ResourceInfoForContainer();
+    unsigned int  alloc();
+    void free(unsigned int index);
+    unsigned int nbRunningContainers()const;
+    bool isContainerRunning(unsigned int index)const;
+    CpuTopology::CpuList& cpus(unsigned int index);
+    void clearCpus() { _cpus.clear();}
+  private:
+    std::vector<bool> _runningContainers; // 0 to max possible containers on this resource
+    unsigned int _nbRunningContainers;
+    unsigned int _firstFreeContainer;
+    // CPUs of every container, kept for the next use of the container.
+    // deque keeps the references valid (see RunInfo::cpus).
+    std::deque<CpuTopology::CpuList> _cpus;
+  };
+
+  class ResourceLoadInfo
+  {
+  public:
+    ResourceLoadInfo(const Resource& r);
+    bool isSupported(const ContainerType& ctype)const;
+    bool isAllocPossible(const ContainerType& ctype)const;
+    float load()const { return _load;}
+    float freeCores()const { return float(_resource.nbCores) - _load;}
+    float loadCost()const { return _loadCost;}
+    unsigned int alloc(const ContainerType& ctype, ContainerTypeHandle handle);
+    void free(const ContainerType& ctype, ContainerTypeHandle handle,
+              int index);
+    bool operator<(const ResourceLoadInfo& other)const
+    { return _resource < other._resource;}
+    bool operator==(const Resource& other)const
+    { return _resource == other;}
+    const Resource& resource()const { return _resource;}
+    bool isReserved()const { return _reserved;}
+    void setReserved(bool reserved) { _reserved = reserved;}
+    // false if some containers are running
+    bool setCpuTopology(const CpuTopology& topology);
+    // nullptr if the containers are not pinned
+    const CpuTopology::CpuList* cpus(const ContainerType& ctype,
+                                     ContainerTypeHandle handle,
+                                     unsigned int index);
+    float COST_FOR_0_CORE_TASKS = 1.0 / 4096.0 ;
+  private:
+    Resource _resource;
+    float _load;
+    float _loadCost;
+    bool _reserved; // kept free for a gang task
+    // index is the type handle, deque keeps the references to the CPUs valid
+    std::deque<ResourceInfoForContainer> _ctypes;
+    CpuTopology _topology; // empty if the containers are not pinned
+    std::vector<unsigned int> _cpuUsers; // index is the CPU id
+
+    bool isPinned(const ContainerType& ctype)const;
+    void pin(const ContainerType& ctype, CpuTopology::CpuList& cpus);
+    void unpin(const CpuTopology::CpuList& cpus);
+  };
+
+  void allocOn(ResourceHandle handle, ContainerTypeHandle typeHandle,
+               RunInfo& worker);
+
+  template <class Placement>
+  bool allocSlot(Task* t, ContainerTypeHandle typeHandle, RunInfo& worker,
+                 const Placement& placement, bool useReserved);
+
+private:
+  static constexpr std::size_t MAX_CACHED_TYPES = 4096;
+  // deques keep the references valid when elements are added.
+  std::deque<ResourceLoadInfo> _resources; // index is the resource handle
+  std::deque<ContainerType> _types; // index is the type handle
+  std::map<ContainerType, ContainerTypeHandle> _typeHandles;
+  // Handles of the types objects of the submitted tasks. Usually the tasks
+  // of a type share the same object, so a task is registered without
+  // looking in _typeHandles.
+  std::unordered_map<const ContainerType*, ContainerTypeHandle> _typeCache;
+  // resources ordered by free cores
+  std::set<std::pair<float, ResourceHandle> > _freeCoresIndex;
+  const Task* _reservingTask; // owner of the reservation, nullptr if none
+  std::list<std::vector<RunInfo> > _runningGangs; // see launchGang
+};
+
+template <class Placement>
+bool ResourcePool::alloc(Task* t, ContainerTypeHandle typeHandle,
+                         RunInfo& worker, const Placement& placement)
+{
+  return allocSlot(t, typeHandle, worker, placement, false);
+}
+
+template <class Placement>
+bool ResourcePool::allocSlot(Task* t, ContainerTypeHandle typeHandle,
+                             RunInfo& worker, const Placement& placement,
+                             bool useReserved)
+{
+  const ContainerType& ctype = _types[typeHandle];
+  std::deque<ResourceLoadInfo>::iterator best_resource;
+  best_resource = _resources.end();
+  float best_cost = 0.0;
+  for(auto itResource = _resources.begin();
+      itResource != _resources.end();
+      itResource++)
+    if(itResource->isSupported(ctype)
+        && t->isAccepted(itResource->resource())
+        && (useReserved || !itResource->isReserved()))
+    {
+      if(itResource->isAllocPossible(ctype))
+      {
+        float thisCost = placement.cost(itResource->resource(),
+                                        itResource->load(),
+                                        itResource->loadCost(),
+                                        ctype);
+        if(thisCost == std::numeric_limits<float>::infinity())
+          continue;
+        if(best_resource == _resources.end() || best_cost > thisCost)
+        {
+          best_cost = thisCost;
+          best_resource = itResource;
+        }
+      }
+    }
+  if(best_resource == _resources.end())
+    return false;
+  allocOn(best_resource - _resources.begin(), typeHandle, worker);
+  return true;
+}
+}
+#endif // RESOURCEPOOL_H
@@ -0,0 +1,217 @@
+// Copyright (C) 2020  CEA/DEN, EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+#include "ShardedManager.hxx"
+#include <limits>
+
+namespace WorkloadManager
+{
+ShardedManager::ShardedManager(unsigned int nbShards)
+: _shards()
+, _routerMutex()
+, _rebalanceCondition()
+, _rebalancePeriod(10)
+, _stop(false)
+, _rebalancer()
+{
+  for(unsigned int i = 0; i < nbShards; i++)
+    _shards.emplace_back();
+}
+
+ShardedManager::~ShardedManager()
+{
+  stop();
+}
+
+void ShardedManager::addResource(const Resource& r)
+{
+  std::unique_lock<std::mutex> lock(_routerMutex);
+  Shard* chosen = &_shards.front();
+  for(Shard& shard : _shards)
+    if(shard.nbCores < chosen->nbCores)
+      chosen = &shard;
+  chosen->resources.push_back(r);
+  chosen->nbCores += r.nbCores;
+  chosen->manager.addResource(r);
+}
+
+bool ShardedManager::addTask(Task* t)
+{
+  Shard* chosen = nullptr;
+  {
+    std::unique_lock<std::mutex> lock(_routerMutex);
+    float bestLoad = 0.0;
+    for(Shard& shard : _shards)
+      if(accepts(shard, t))
+      {
+        float shardLoad = load(shard);
+        if(chosen == nullptr || shardLoad < bestLoad)
+        {
+          chosen = &shard;
+          bestLoad = shardLoad;
+        }
+      }
+    if(chosen == nullptr)
+      return false;
+  }
+  chosen->manager.addTask(t);
+  return true;
+}
+
+void ShardedManager::setDataSetLocation(const std::string& dataSet,
+                                        const std::string& resourceName)
+{
+  for(Shard& shard : _shards)
+    shard.manager.setDataSetLocation(dataSet, resourceName);
+}
+
+void ShardedManager::setPlacementMode(DefaultAlgorithm::PlacementMode mode)
+{
+  for(Shard& shard : _shards)
+    shard.manager.setPlacementMode(mode);
+}
+
+void ShardedManager::setRebalancePeriod(const std::chrono::milliseconds& period)
+{
+  std::unique_lock<std::mutex> lock(_routerMutex);
+  _rebalancePeriod = period;
+}
+
+unsigned int ShardedManager::nbShards()const
+{
+  return _shards.size();
+}
+
+void ShardedManager::start()
+{
+  for(Shard& shard : _shards)
+    shard.manager.start();
+  std::unique_lock<std::mutex> lock(_routerMutex);
+  _stop = false;
+  if(_rebalancePeriod.count() > 0 && !_rebalancer.joinable())
+    _rebalancer = std::thread([this]
+      {
+        rebalanceTasks();
+      });
+}
+
+void ShardedManager::stop()
+{
+  // The waiting tasks can still go to another shard until they are all
+  // launched. A task taken by a shard after its waitAll is seen by the next
+  // loop. The tasks are not moved any more while the shards are stopping.
+  {
+    std::unique_lock<std::mutex> lock(_routerMutex);
+    while(_rebalancer.joinable() && hasWaitingTasks())
+    {
+      lock.unlock();
+      for(Shard& shard : _shards)
+        shard.manager.waitAll();
+      lock.lock();
+    }
+    _stop = true;
+  }
+  _rebalanceCondition.notify_one();
+  if(_rebalancer.joinable())
+    _rebalancer.join();
+  for(Shard& shard : _shards)
+    shard.manager.stop();
+}
+
+bool ShardedManager::accepts(const Shard& shard, Task* t)const
+{
+  const ContainerType& ctype = t->type();
+  if(ctype.ignoreResources)
+    return true;
+  unsigned int nbSlots = 0;
+  for(const Resource& r : shard.resources)
+    if(ctype.neededCores <= r.nbCores && t->isAccepted(r))
+    {
+      if(ctype.neededCores == 0)
+        return true;
+      nbSlots += r.nbCores / ctype.neededCores;
+      if(nbSlots >= ctype.gangSize)
+        return true;
+    }
+  return false;
+}
+
+float ShardedManager::load(Shard& shard)const
+{
+  if(shard.nbCores == 0)
+    return std::numeric_limits<float>::infinity();
+  std::size_t nbTasks = shard.manager.nbWaitingTasks()
+                      + shard.manager.nbRunningTasks();
+  return float(nbTasks) / shard.nbCores;
+}
+
+bool ShardedManager::hasWaitingTasks()
+{
+  for(Shard& shard : _shards)
+    if(shard.manager.nbWaitingTasks() > 0)
+      return true;
+  return false;
+}
+
+void ShardedManager::rebalance()
+{
+  for(Shard& idle : _shards)
+  {
+    // The number of running tasks is an estimation of the used cores.
+    if(idle.manager.nbWaitingTasks() > 0
+       || idle.manager.nbRunningTasks() >= idle.nbCores)
+      continue;
+    Shard* busiest = nullptr;
+    std::size_t maxWaiting = 0;
+    for(Shard& shard : _shards)
+    {
+      std::size_t nbWaiting = shard.manager.nbWaitingTasks();
+      if(&shard != &idle && nbWaiting > maxWaiting)
+      {
+        busiest = &shard;
+        maxWaiting = nbWaiting;
+      }
+    }
+    if(busiest == nullptr)
+      continue;
+    // take half of the waiting tasks
+    for(std::size_t i = 0; i < (maxWaiting + 1) / 2; i++)
+    {
+      Task* t = busiest->manager.takeWaitingTask([this, &idle](Task* task)
+        {
+          return accepts(idle, task);
+        });
+      if(t == nullptr)
+        break;
+      idle.manager.addTask(t);
+    }
+  }
+}
+
+void ShardedManager::rebalanceTasks()
+{
+  std::unique_lock<std::mutex> lock(_routerMutex);
+  while(!_stop)
+  {
+    _rebalanceCondition.wait_for(lock, _rebalancePeriod,
+                                 [this] {return _stop;});
+    if(!_stop)
+      rebalance();
+  }
+}
+}
@@ -0,0 +1,89 @@
+// Copyright (C) 2020  CEA/DEN, EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+#ifndef SHARDEDMANAGER_H
+#define SHARDEDMANAGER_H
+
+#include "WorkloadManager.hxx"
+#include "DefaultAlgorithm.hxx"
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <vector>
+#include <chrono>
+
+namespace WorkloadManager
+{
+/**
+ * Scheduler for a large number of resources. The resources are split in
+ * shards and every shard is an independent WorkloadManager with its own
+ * DefaultAlgorithm, its own lock and its own threads.
+ * A new task is sent to the less loaded shard which can run it. A shard
+ * without waiting tasks and with free cores takes waiting tasks from the
+ * busiest shard from time to time.
+ */
+class ShardedManager
+{
+public:
+  ShardedManager(unsigned int nbShards);
+  ShardedManager(const ShardedManager&) = delete;
+  ~ShardedManager();
+  // The resource goes to the shard with the fewest cores.
+  void addResource(const Resource& r);
+  // Return false if no shard can ever run the task, which is not added.
+  bool addTask(Task* t);
+  // see WorkloadManager and DefaultAlgorithm
+  void setDataSetLocation(const std::string& dataSet,
+                          const std::string& resourceName);
+  void setPlacementMode(DefaultAlgorithm::PlacementMode mode);
+  // Time between two rebalancings of the waiting tasks. 0 means no
+  // rebalancing. Default is 10ms. Taken into account by start.
+  void setRebalancePeriod(const std::chrono::milliseconds& period);
+  unsigned int nbShards()const;
+  void start(); //! start execution
+  void stop(); //! stop execution
+
+private:
+  struct Shard
+  {
+    Shard() : algo(), manager(algo), resources(), nbCores(0) {}
+    DefaultAlgorithm algo;
+    WorkloadManager manager;
+    std::vector<Resource> resources;
+    unsigned int nbCores;
+  };
+
+  // The following functions are called under the router lock.
+  bool accepts(const Shard& shard, Task* t)const;
+  float load(Shard& shard)const;
+  bool hasWaitingTasks();
+  void rebalance();
+
+  void rebalanceTasks();
+
+private:
+  std::deque<Shard> _shards; // deque because Shard cannot be moved
+  std::mutex _routerMutex; // protects the resources of the shards
+  std::condition_variable _rebalanceCondition;
+  std::chrono::milliseconds _rebalancePeriod;
+  bool _stop;
+  std::thread _rebalancer;
+};
+}
+#endif // SHARDEDMANAGER_H
@@ -20,6 +20,7 @@
 #define _TASK_H_
 
 #include <string>
+#include <vector>
 
 namespace WorkloadManager
 {
@@ -30,6 +31,9 @@ namespace WorkloadManager
     bool ignoreResources = false; // if true, the task can be run as soon as
                                   // added to the manager without any resource
                                   // allocation
+    unsigned int gangSize = 1; // number of containers launched at the same
+                               // time for a task, possibly on several
+                               // resources (gang scheduling)
     // parameters for client use, used by WorkloadManager to distinguish objects
     std::string name;
     int id = 0;
@@ -57,11 +61,35 @@ namespace WorkloadManager
     }
   };
   
+  // Handles of the types and of the resources registered by the algorithm.
+  typedef unsigned int ContainerTypeHandle;
+  typedef unsigned int ResourceHandle;
+
   struct RunInfo
   {
-    ContainerType type;
-    Resource resource;
+    // The type and the resource are registered copies owned by the algorithm.
+    const ContainerType* type = nullptr;
+    const Resource* resource = nullptr; // nullptr if resources are ignored
     unsigned int index=0; // worker index on the resource for this type
+    ContainerTypeHandle typeHandle = 0;
+    ResourceHandle resourceHandle = 0;
+    // Containers of a gang task (see ContainerType::gangSize), nullptr for
+    // the other tasks. The first one is the same as this RunInfo.
+    const std::vector<RunInfo>* gang = nullptr;
+    // CPUs where the container is pinned, nullptr if it is not pinned
+    // (see ResourcePool::setCpuTopology). The same container keeps the
+    // same CPUs when they are free.
+    const std::vector<int>* cpus = nullptr;
+  };
+
+  // Location of the data used by a task.
+  struct LocalityHint
+  {
+    // The data is on the resource with this name, or on the resources of
+    // the data set (see WorkloadManager::setDataSetLocation).
+    std::string resourceName;
+    std::string dataSet;
+    float weight = 1.0; // cost of the transfer of the data (ex: size in GB)
   };
 
   /**
@@ -80,6 +108,29 @@ namespace WorkloadManager
       // by default, a task can be run on any resource.
       return true;
     }
+
+    // Fair-share group of the task (user, schema execution...).
+    // Only used by FairShareAlgorithm.
+    virtual int group()const
+    {
+      return 0;
+    }
+
+    // Stable identifier of the task between two executions of the
+    // process, used by the journal (see WorkloadManager::setJournal).
+    // The tasks with an empty key are not recorded.
+    virtual const std::string& key()const
+    {
+      static const std::string noKey;
+      return noKey;
+    }
+
+    // Where the data of the task is. Read when the task is added.
+    // Only used by DefaultAlgorithm.
+    virtual std::vector<LocalityHint> localityHints()const
+    {
+      return std::vector<LocalityHint>();
+    }
   };
 }
 
@@ -0,0 +1,317 @@
+// Copyright (C) 2020  CEA/DEN, EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+#include "TaskJournal.hxx"
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <algorithm>
+#include <iterator>
+#include <atomic>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace WorkloadManager
+{
+constexpr std::size_t TaskJournal::HEADER_SIZE;
+constexpr std::size_t TaskJournal::MIN_CAPACITY;
+
+static const char JOURNAL_MAGIC[8] = {'W', 'L', 'M', 'J', 'R', 'N', 'L', '1'};
+
+static bool writeAll(int fd, const char* data, std::size_t size)
+{
+  while(size > 0)
+  {
+    ssize_t written = ::write(fd, data, size);
+    if(written < 0 && errno == EINTR)
+      continue;
+    if(written <= 0)
+      return false;
+    data += written;
+    size -= written;
+  }
+  return true;
+}
+
+TaskJournal::TaskJournal(const std::string& path)
+: _path(path)
+, _fd(-1)
+, _data(nullptr)
+, _capacity(0)
+, _size(HEADER_SIZE)
+, _nbRecords(0)
+, _compacting(false)
+, _pending()
+, _pendingIndex()
+{
+  _fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if(_fd < 0)
+    throw std::runtime_error("Cannot open the journal " + path + ": "
+                             + std::strerror(errno));
+  struct stat fileStat;
+  if(::fstat(_fd, &fileStat) != 0)
+  {
+    int error = errno;
+    ::close(_fd);
+    throw std::runtime_error("Cannot stat the journal " + path + ": "
+                             + std::strerror(error));
+  }
+  if(fileStat.st_size == 0)
+  {
+    map(MIN_CAPACITY);
+    std::memcpy(_data, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    setSize(HEADER_SIZE);
+  }
+  else
+  {
+    map(fileStat.st_size);
+    if(fileStat.st_size < static_cast<off_t>(HEADER_SIZE)
+       || std::memcmp(_data, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0)
+    {
+      unmap();
+      ::close(_fd);
+      throw std::runtime_error("Not a journal: " + path);
+    }
+    load();
+  }
+}
+
+TaskJournal::~TaskJournal()
+{
+  unmap();
+  if(_fd >= 0)
+    ::close(_fd);
+}
+
+void TaskJournal::recordSubmitted(const std::string& key)
+{
+  if(_pendingIndex.count(key) > 0)
+    return;
+  // The pending tasks are not changed if the record cannot be written.
+  append(SUBMITTED, key);
+  apply(SUBMITTED, key);
+}
+
+void TaskJournal::recordCompleted(const std::string& key)
+{
+  if(_pendingIndex.count(key) == 0)
+    return;
+  append(COMPLETED, key);
+  apply(COMPLETED, key);
+}
+
+std::vector<std::string> TaskJournal::pendingKeys()const
+{
+  return std::vector<std::string>(_pending.begin(), _pending.end());
+}
+
+bool TaskJournal::needsCompaction()const
+{
+  // Amortized: the records are rewritten when most of them are obsolete.
+  return !_compacting && _nbRecords > 2 * _pending.size() + 1024;
+}
+
+bool TaskJournal::compact()
+{
+  Compaction compaction;
+  beginCompaction(compaction);
+  writeCompaction(compaction);
+  return endCompaction(compaction);
+}
+
+void TaskJournal::beginCompaction(Compaction& compaction)
+{
+  _compacting = true;
+  std::string records;
+  for(const std::string& key : _pending)
+  {
+    std::uint32_t length = key.size();
+    records.push_back(SUBMITTED);
+    records.append(reinterpret_cast<const char*>(&length), sizeof(length));
+    records.append(key);
+  }
+  std::uint64_t size = HEADER_SIZE + records.size();
+  compaction.content.assign(JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+  compaction.content.append(reinterpret_cast<const char*>(&size),
+                            sizeof(size));
+  compaction.content += records;
+  compaction.nbRecords = _pending.size();
+  compaction.oldSize = _size;
+  compaction.oldNbRecords = _nbRecords;
+  compaction.fd = -1;
+}
+
+void TaskJournal::writeCompaction(Compaction& compaction)const
+{
+  std::string newPath = _path + ".compact";
+  int newFd = ::open(newPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if(newFd < 0)
+    return;
+  if(!writeAll(newFd, compaction.content.data(), compaction.content.size())
+     || ::fsync(newFd) != 0)
+  {
+    ::close(newFd);
+    ::unlink(newPath.c_str());
+    return;
+  }
+  compaction.fd = newFd;
+}
+
+bool TaskJournal::endCompaction(Compaction& compaction)
+{
+  _compacting = false;
+  if(compaction.fd < 0)
+    return false;
+  // The new file replaces the old one only when it is complete.
+  std::string newPath = _path + ".compact";
+  auto cancel = [&compaction, &newPath]
+    {
+      ::close(compaction.fd);
+      ::unlink(newPath.c_str());
+      compaction.fd = -1;
+      return false;
+    };
+  // records added during the compaction
+  std::size_t tailSize = _size - compaction.oldSize;
+  if(!writeAll(compaction.fd, _data + compaction.oldSize, tailSize))
+    return cancel();
+  std::size_t size = compaction.content.size() + tailSize;
+  std::size_t capacity = std::max<std::size_t>(MIN_CAPACITY, 2 * size);
+  if(::ftruncate(compaction.fd, capacity) != 0)
+    return cancel();
+  void* data = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      compaction.fd, 0);
+  if(data == MAP_FAILED)
+    return cancel();
+  if(::rename(newPath.c_str(), _path.c_str()) != 0)
+  {
+    ::munmap(data, capacity);
+    return cancel();
+  }
+  unmap();
+  ::close(_fd);
+  _fd = compaction.fd;
+  _data = static_cast<char*>(data);
+  _capacity = capacity;
+  setSize(size);
+  _nbRecords = compaction.nbRecords + _nbRecords - compaction.oldNbRecords;
+  compaction.fd = -1;
+  return true;
+}
+
+void TaskJournal::sync()
+{
+  ::msync(_data, _size, MS_SYNC);
+}
+
+void TaskJournal::map(std::size_t capacity)
+{
+  if(::ftruncate(_fd, capacity) != 0)
+    throw std::runtime_error("Cannot resize the journal " + _path + ": "
+                             + std::strerror(errno));
+  void* data = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      _fd, 0);
+  if(data == MAP_FAILED)
+    throw std::runtime_error("Cannot map the journal " + _path + ": "
+                             + std::strerror(errno));
+  unmap();
+  _data = static_cast<char*>(data);
+  _capacity = capacity;
+}
+
+void TaskJournal::unmap()
+{
+  if(_data)
+    ::munmap(_data, _capacity);
+  _data = nullptr;
+  _capacity = 0;
+}
+
+void TaskJournal::load()
+{
+  std::uint64_t size = 0;
+  std::memcpy(&size, _data + sizeof(JOURNAL_MAGIC), sizeof(size));
+  if(size > _capacity)
+    size = _capacity;
+  std::size_t pos = HEADER_SIZE;
+  while(pos + 1 + sizeof(std::uint32_t) <= size)
+  {
+    RecordType type = static_cast<RecordType>(_data[pos]);
+    std::uint32_t length = 0;
+    std::memcpy(&length, _data + pos + 1, sizeof(length));
+    std::size_t keyPos = pos + 1 + sizeof(length);
+    if(keyPos + length > size)
+      break;
+    apply(type, std::string(_data + keyPos, length));
+    _nbRecords++;
+    pos = keyPos + length;
+  }
+  _size = pos;
+}
+
+void TaskJournal::apply(RecordType type, const std::string& key)
+{
+  auto it = _pendingIndex.find(key);
+  if(type == SUBMITTED)
+  {
+    if(it == _pendingIndex.end())
+    {
+      _pending.push_back(key);
+      _pendingIndex.emplace(key, std::prev(_pending.end()));
+    }
+  }
+  else if(type == COMPLETED)
+  {
+    if(it != _pendingIndex.end())
+    {
+      _pending.erase(it->second);
+      _pendingIndex.erase(it);
+    }
+  }
+}
+
+void TaskJournal::append(RecordType type, const std::string& key)
+{
+  std::uint32_t length = key.size();
+  std::size_t recordSize = 1 + sizeof(length) + length;
+  if(_size + recordSize > _capacity)
+  {
+    std::size_t capacity = 2 * _capacity;
+    while(_size + recordSize > capacity)
+      capacity *= 2;
+    map(capacity);
+  }
+  char* record = _data + _size;
+  record[0] = type;
+  std::memcpy(record + 1, &length, sizeof(length));
+  std::memcpy(record + 1 + sizeof(length), key.data(), length);
+  // The record is valid when the size in the header includes it.
+  std::atomic_signal_fence(std::memory_order_release);
+  setSize(_size + recordSize);
+  _nbRecords++;
+}
+
+void TaskJournal::setSize(std::uint64_t size)
+{
+  _size = size;
+  std::memcpy(_data + sizeof(JOURNAL_MAGIC), &size, sizeof(size));
+}
+}
@@ -0,0 +1,117 @@
+// Copyright (C) 2020  CEA/DEN, EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+#ifndef TASKJOURNAL_H
+#define TASKJOURNAL_H
+
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <cstdint>
+
+namespace WorkloadManager
+{
+/**
+ * Persistent journal of the submissions and of the completions of the tasks
+ * (see Task::key and WorkloadManager::setJournal). After a crash, the
+ * tasks which were submitted and not completed are added again to the
+ * manager (see WorkloadManager::recoverTasks) and the completed tasks are
+ * not run again.
+ * The records are appended to a memory-mapped file. The file starts with a
+ * header which contains the size of the valid records, updated after every
+ * record, so a record interrupted by a crash is ignored.
+ * When most of the records are obsolete, the file is compacted: it is
+ * rewritten with the submissions of the pending tasks only, so the time to
+ * open the journal depends on the number of pending tasks, not on the
+ * history.
+ * It is not thread safe. The manager uses it under its lock, except for
+ * writeCompaction, so the copy of the records and the fsync do not block
+ * the manager.
+ */
+class TaskJournal
+{
+public:
+  // Open the journal, or create it if it does not exist.
+  TaskJournal(const std::string& path);
+  TaskJournal(const TaskJournal&) = delete;
+  ~TaskJournal();
+  // A task already submitted and not completed is not recorded again.
+  void recordSubmitted(const std::string& key);
+  void recordCompleted(const std::string& key);
+  // Submitted and not completed tasks, in the order of submission.
+  std::vector<std::string> pendingKeys()const;
+  std::size_t nbRecords()const { return _nbRecords;}
+  // Most of the records are obsolete and no compaction is in progress.
+  bool needsCompaction()const;
+  // Rewrite the file with the submissions of the pending tasks. Return
+  // false if the current file is kept.
+  bool compact();
+
+  // Compaction in 3 steps. The records added between beginCompaction and
+  // endCompaction are kept.
+  struct Compaction
+  {
+    std::string content; // header and submissions of the pending tasks
+    std::size_t nbRecords = 0;
+    std::size_t oldSize = 0; // size of the journal at the beginning
+    std::size_t oldNbRecords = 0;
+    int fd = -1; // new file, -1 if it could not be written
+  };
+  void beginCompaction(Compaction& compaction);
+  // Write and flush the new file. It can be called concurrently with the
+  // other functions.
+  void writeCompaction(Compaction& compaction)const;
+  // Replace the file by the new one. Return false if the current file is
+  // kept.
+  bool endCompaction(Compaction& compaction);
+  // Flush the records to the disk. Without it, the records survive a crash
+  // of the process, but not a crash of the system.
+  void sync();
+
+private:
+  enum RecordType : std::uint8_t
+  {
+    SUBMITTED = 1,
+    COMPLETED = 2
+  };
+  static constexpr std::size_t HEADER_SIZE = 16; // magic and records size
+  static constexpr std::size_t MIN_CAPACITY = 1 << 20;
+
+  // The current mapping is kept if the new one fails.
+  void map(std::size_t capacity);
+  void unmap();
+  void load();
+  void apply(RecordType type, const std::string& key);
+  void append(RecordType type, const std::string& key);
+  void setSize(std::uint64_t size);
+
+private:
+  std::string _path;
+  int _fd;
+  char* _data;
+  std::size_t _capacity;
+  std::size_t _size; // header and valid records
+  std::size_t _nbRecords;
+  bool _compacting;
+  std::list<std::string> _pending;
+  std::unordered_map<std::string, std::list<std::string>::iterator>
+                                                                _pendingIndex;
+};
+}
+#endif // TASKJOURNAL_H
@@ -30,9 +30,31 @@
 #include <chrono>
 #include <ctime>
 #include <thread>
+#include <mutex>
+#include <algorithm>
+#include <vector>
+#include <future>
+#include <memory>
 
 #include "../WorkloadManager.hxx"
 #include "../DefaultAlgorithm.hxx"
+#include "../FairShareAlgorithm.hxx"
+#include "../PolicyAlgorithm.hxx"
+#include "../AgentServer.hxx"
+#include "../AgentProtocol.hxx"
+#include "../WorkerAgent.hxx"
+#include "../ShardedManager.hxx"
+#include "../CpuTopology.hxx"
+#include "../TaskJournal.hxx"
+#include "../ResourcePool.hxx"
+
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <sched.h>
+#include <poll.h>
+#include <csignal>
+#include <sys/resource.h>
 
 constexpr bool ACTIVATE_DEBUG_LOG = false;
 template<typename... Ts>
@@ -82,8 +104,9 @@ public:
   {
     _check->check(c, this);
 
-    DEBUG_LOG("Running task ", _id, " on ", c.resource.name, "-", c.type.name,
-              "-", c.index);
+    DEBUG_LOG("Running task ", _id, " on ",
+              c.resource ? c.resource->name : std::string("no resource"),
+              "-", c.type->name, "-", c.index);
     std::this_thread::sleep_for(std::chrono::seconds(_sleep));
     DEBUG_LOG("Finish task ", _id);
   }
@@ -134,8 +157,10 @@ template <std::size_t size_R, std::size_t size_T>
 void Checker<size_R, size_T>::check(const WorkloadManager::RunInfo& c,
                                     MyTask* t)
 {
+  if(c.resource == nullptr) // resources are ignored
+    return;
   std::unique_lock<std::mutex> lock(_mutex);
-  int& max = _maxContainersForResource[c.resource.id][c.type.id];
+  int& max = _maxContainersForResource[c.resource->id][c.type->id];
   if( max < c.index)
     max = c.index;
 }
@@ -168,15 +193,360 @@ void Checker<size_R, size_T>::reset()
       _maxContainersForResource[i][j] = 0;
 }
 
+/**
+ * Short task which records its launch order.
+ */
+class OrderedTask : public WorkloadManager::Task
+{
+public:
+  const WorkloadManager::ContainerType& type()const override {return *_type;}
+  int group()const override {return _group;}
+  void run(const WorkloadManager::RunInfo& c)override
+  {
+    {
+      std::unique_lock<std::mutex> lock(*_mutex);
+      _launchOrder = (*_launchCounter)++;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(_sleep));
+  }
+
+  void reset(const WorkloadManager::ContainerType* type,
+             int group,
+             int sleep,
+             std::mutex* mutex,
+             int* launchCounter)
+  {
+    _type = type;
+    _group = group;
+    _sleep = sleep;
+    _mutex = mutex;
+    _launchCounter = launchCounter;
+    _launchOrder = -1;
+  }
+  int launchOrder()const {return _launchOrder;}
+private:
+  const WorkloadManager::ContainerType* _type = nullptr;
+  int _group = 0;
+  int _sleep = 0; // ms
+  std::mutex* _mutex = nullptr;
+  int* _launchCounter = nullptr;
+  int _launchOrder = -1;
+};
+
+/**
+ * Task which counts the calls of isAccepted.
+ */
+class AcceptCountingTask : public OrderedTask
+{
+public:
+  bool isAccepted(const WorkloadManager::Resource& r)override
+  {
+    (*_nbAccepts)++;
+    return true;
+  }
+  void setAcceptCounter(int* nbAccepts) { _nbAccepts = nbAccepts;}
+private:
+  int* _nbAccepts = nullptr;
+};
+
+/**
+ * Task which checks the number of cores used at the same time on a resource.
+ */
+class CountingTask : public WorkloadManager::Task
+{
+public:
+  const WorkloadManager::ContainerType& type()const override {return *_type;}
+  void run(const WorkloadManager::RunInfo& c)override
+  {
+    {
+      std::unique_lock<std::mutex> lock(*_mutex);
+      *_usedCores += _type->neededCores;
+      *_maxUsedCores = std::max(*_maxUsedCores, *_usedCores);
+      if(*_maxIndex < int(c.index))
+        *_maxIndex = c.index;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(_sleep));
+    {
+      std::unique_lock<std::mutex> lock(*_mutex);
+      *_usedCores -= _type->neededCores;
+    }
+  }
+
+  void reset(const WorkloadManager::ContainerType* type,
+             int sleep,
+             std::mutex* mutex,
+             float* usedCores,
+             float* maxUsedCores,
+             int* maxIndex)
+  {
+    _type = type;
+    _sleep = sleep;
+    _mutex = mutex;
+    _usedCores = usedCores;
+    _maxUsedCores = maxUsedCores;
+    _maxIndex = maxIndex;
+  }
+private:
+  const WorkloadManager::ContainerType* _type = nullptr;
+  int _sleep = 0; // ms
+  std::mutex* _mutex = nullptr;
+  float* _usedCores = nullptr;
+  float* _maxUsedCores = nullptr;
+  int* _maxIndex = nullptr;
+};
+
+/**
+ * Task which records the resource where it was run.
+ */
+class PlacedTask : public WorkloadManager::Task
+{
+public:
+  const WorkloadManager::ContainerType& type()const override {return *_type;}
+  void run(const WorkloadManager::RunInfo& c)override
+  {
+    _resourceId = c.resource->id;
+    std::this_thread::sleep_for(std::chrono::milliseconds(_sleep));
+  }
+
+  void reset(const WorkloadManager::ContainerType* type, int sleep)
+  {
+    _type = type;
+    _sleep = sleep;
+    _resourceId = -1;
+  }
+  int resourceId()const {return _resourceId;}
+private:
+  const WorkloadManager::ContainerType* _type = nullptr;
+  int _sleep = 0; // ms
+  int _resourceId = -1;
+};
+
+/**
+ * Gang task which records its launch order and its containers.
+ */
+class GangTask : public WorkloadManager::Task
+{
+public:
+  const WorkloadManager::ContainerType& type()const override {return *_type;}
+  void run(const WorkloadManager::RunInfo& c)override
+  {
+    {
+      std::unique_lock<std::mutex> lock(*_mutex);
+      _launchOrder = (*_launchCounter)++;
+    }
+    if(c.gang)
+      for(const WorkloadManager::RunInfo& slot : *c.gang)
+        _resourceIds.push_back(slot.resource->id);
+    std::this_thread::sleep_for(std::chrono::milliseconds(_sleep));
+  }
+
+  void reset(const WorkloadManager::ContainerType* type,
+             int sleep,
+             std::mutex* mutex,
+             int* launchCounter)
+  {
+    _type = type;
+    _sleep = sleep;
+    _mutex = mutex;
+    _launchCounter = launchCounter;
+    _launchOrder = -1;
+    _resourceIds.clear();
+  }
+  int launchOrder()const {return _launchOrder;}
+  const std::vector<int>& resourceIds()const {return _resourceIds;}
+private:
+  const WorkloadManager::ContainerType* _type = nullptr;
+  int _sleep = 0; // ms
+  std::mutex* _mutex = nullptr;
+  int* _launchCounter = nullptr;
+  int _launchOrder = -1;
+  std::vector<int> _resourceIds;
+};
+
+/**
+ * Task which records the thread and the container where it was run.
+ */
+class BatchedTask : public WorkloadManager::Task
+{
+public:
+  const WorkloadManager::ContainerType& type()const override {return *_type;}
+  void run(const WorkloadManager::RunInfo& c)override
+  {
+    _threadId = std::this_thread::get_id();
+    _index = c.index;
+    std::this_thread::sleep_for(std::chrono::milliseconds(_sleep));
+  }
+
+  void reset(const WorkloadManager::ContainerType* type, int sleep)
+  {
+    _type = type;
+    _sleep = sleep;
+    _index = -1;
+  }
+  std::thread::id threadId()const {return _threadId;}
+  int index()const {return _index;}
+private:
+  const WorkloadManager::ContainerType* _type = nullptr;
+  int _sleep = 0; // ms
+  std::thread::id _threadId;
+  int _index = -1;
+};
+
+/**
+ * Task run by a worker agent, which records the status of the run.
+ */
+class MyRemoteTask : public WorkloadManager::RemoteTask
+{
+public:
+  MyRemoteTask(WorkloadManager::AgentServer& server)
+  : WorkloadManager::RemoteTask(server)
+  {
+  }
+  const WorkloadManager::ContainerType& type()const override {return *_type;}
+  std::string descriptor()const override {return _descriptor;}
+  void finished(int status)override {_status = status;}
+
+  void reset(const WorkloadManager::ContainerType* type,
+             const std::string& descriptor)
+  {
+    _type = type;
+    _descriptor = descriptor;
+    _status = -100;
+  }
+  int status()const {return _status;}
+private:
+  const WorkloadManager::ContainerType* _type = nullptr;
+  std::string _descriptor;
+  int _status = -100;
+};
+
+/**
+ * Task with locality hints, which records the resource where it was run.
+ */
+class LocalTask : public PlacedTask
+{
+public:
+  std::vector<WorkloadManager::LocalityHint> localityHints()const override
+  {
+    return _hints;
+  }
+  void setHint(const WorkloadManager::LocalityHint& hint)
+  {
+    _hints.assign(1, hint);
+  }
+private:
+  std::vector<WorkloadManager::LocalityHint> _hints;
+};
+
+/**
+ * Task which can only run on one resource, or on any resource if the id of
+ * the resource is -1.
+ */
+class PinnedTask : public PlacedTask
+{
+public:
+  bool isAccepted(const WorkloadManager::Resource& r)override
+  {
+    return _acceptedId < 0 || r.id == _acceptedId;
+  }
+  void setAcceptedResource(int id) { _acceptedId = id;}
+private:
+  int _acceptedId = -1;
+};
+
+/**
+ * Task with a key for the journal.
+ */
+class KeyedTask : public PlacedTask
+{
+public:
+  const std::string& key()const override { return _key;}
+  void setKey(const std::string& key) { _key = key;}
+private:
+  std::string _key;
+};
+
+/**
+ * Task which records its container, its CPUs and the affinity of its thread.
+ */
+class CpuTask : public WorkloadManager::Task
+{
+public:
+  const WorkloadManager::ContainerType& type()const override {return *_type;}
+  void run(const WorkloadManager::RunInfo& c)override
+  {
+    _index = c.index;
+    if(c.cpus)
+      _cpus = *c.cpus;
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    sched_getaffinity(0, sizeof(cpu_set_t), &cpuSet);
+    _affinity.clear();
+    for(int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+      if(CPU_ISSET(cpu, &cpuSet))
+        _affinity.push_back(cpu);
+    std::this_thread::sleep_for(std::chrono::milliseconds(_sleep));
+  }
+
+  void reset(const WorkloadManager::ContainerType* type, int sleep)
+  {
+    _type = type;
+    _sleep = sleep;
+    _cpus.clear();
+    _affinity.clear();
+  }
+  unsigned int index()const {return _index;}
+  const std::vector<int>& cpus()const {return _cpus;}
+  const std::vector<int>& affinity()const {return _affinity;}
+private:
+  const WorkloadManager::ContainerType* _type = nullptr;
+  int _sleep = 0; // ms
+  unsigned int _index = 0;
+  std::vector<int> _cpus;
+  std::vector<int> _affinity;
+};
+
 class MyTest: public CppUnit::TestFixture
 {
   CPPUNIT_TEST_SUITE(MyTest);
   CPPUNIT_TEST(atest);
   CPPUNIT_TEST(btest);
+  CPPUNIT_TEST(fairShareTest);
+  CPPUNIT_TEST(brokerTest);
+  CPPUNIT_TEST(placementTest);
+  CPPUNIT_TEST(admissionTest);
+  CPPUNIT_TEST(gangTest);
+  CPPUNIT_TEST(batchTest);
+  CPPUNIT_TEST(agentTest);
+  CPPUNIT_TEST(localityTest);
+  CPPUNIT_TEST(consolidationTest);
+  CPPUNIT_TEST(shardTest);
+  CPPUNIT_TEST(pinningTest);
+  CPPUNIT_TEST(journalTest);
+  CPPUNIT_TEST(lifecycleTest);
+  CPPUNIT_TEST(typeHandleTest);
+  CPPUNIT_TEST(agentProtocolTest);
+  CPPUNIT_TEST(agentLaunchTest);
   CPPUNIT_TEST_SUITE_END();
 public:
   void atest();
   void btest(); // ignore resources
+  void fairShareTest();
+  void brokerTest(); // several managers share the same resources
+  void placementTest(); // policy based algorithms
+  void admissionTest(); // bounded queue
+  void gangTest(); // tasks on several resources
+  void batchTest(); // several tasks in the same launch
+  void agentTest(); // tasks run by an agent process
+  void localityTest(); // placement near the data
+  void consolidationTest(); // keep whole resources free
+  void shardTest(); // several independent managers
+  void pinningTest(); // containers pinned to CPUs
+  void journalTest(); // restart after a crash
+  void lifecycleTest(); // wait without stopping, pause and resume
+  void typeHandleTest(); // registration of the container types
+  void agentProtocolTest(); // bad frames from an agent
+  void agentLaunchTest(); // end of the launches
 };
 
 /**
@@ -305,6 +675,1172 @@ void MyTest::btest()
   CPPUNIT_ASSERT( duration <= maxExpectedDuration);
 }
 
+/**
+ * A group submits a lot of tasks before another one. With the fair-share
+ * algorithm, the tasks of the second group should not wait for the end of
+ * the first group. The third group has a double weight.
+ * When the resources are full, the choice of a task is cheap.
+ */
+void MyTest::fairShareTest()
+{
+  WorkloadManager::Resource resource;
+  resource.nbCores = 2;
+  resource.name = "r0";
+  WorkloadManager::ContainerType ctype;
+  ctype.neededCores = 1.0;
+  ctype.name = "t0";
+
+  constexpr std::size_t bigGroupSize = 40;
+  constexpr std::size_t smallGroupSize = 4;
+  std::mutex mutex;
+  int launchCounter = 0;
+  OrderedTask bigGroup[bigGroupSize];
+  OrderedTask smallGroup[smallGroupSize];
+  OrderedTask heavyGroup[smallGroupSize];
+  for(std::size_t i = 0; i < bigGroupSize; i++)
+    bigGroup[i].reset(&ctype, 0, 20, &mutex, &launchCounter);
+  for(std::size_t i = 0; i < smallGroupSize; i++)
+  {
+    smallGroup[i].reset(&ctype, 1, 20, &mutex, &launchCounter);
+    heavyGroup[i].reset(&ctype, 2, 20, &mutex, &launchCounter);
+  }
+
+  WorkloadManager::FairShareAlgorithm algo;
+  CPPUNIT_ASSERT(algo.setGroupWeight(2, 2.0));
+  CPPUNIT_ASSERT(!algo.setGroupWeight(1, 0.0));
+  CPPUNIT_ASSERT(!algo.setGroupWeight(1, -1.0));
+  WorkloadManager::WorkloadManager wlm(algo);
+  wlm.addResource(resource);
+  for(std::size_t i = 0; i < bigGroupSize; i++)
+    wlm.addTask(&bigGroup[i]);
+  for(std::size_t i = 0; i < smallGroupSize; i++)
+    wlm.addTask(&smallGroup[i]);
+  for(std::size_t i = 0; i < smallGroupSize; i++)
+    wlm.addTask(&heavyGroup[i]);
+  wlm.start();
+  wlm.stop();
+
+  CPPUNIT_ASSERT(launchCounter == bigGroupSize + 2 * smallGroupSize);
+  int lastSmall = 0;
+  int lastHeavy = 0;
+  for(std::size_t i = 0; i < smallGroupSize; i++)
+  {
+    lastSmall = std::max(lastSmall, smallGroup[i].launchOrder());
+    lastHeavy = std::max(lastHeavy, heavyGroup[i].launchOrder());
+  }
+  DEBUG_LOG("Last launch of the small group: ", lastSmall,
+            ", last launch of the heavy group: ", lastHeavy);
+  // 3 groups share the resource until the small groups are finished.
+  CPPUNIT_ASSERT(lastSmall < 4 * int(smallGroupSize));
+  CPPUNIT_ASSERT(lastHeavy < lastSmall);
+  // The choice which finds nothing does not try all the waiting tasks.
+  WorkloadManager::Resource bigResource;
+  bigResource.nbCores = 3;
+  WorkloadManager::ContainerType bigType;
+  bigType.neededCores = 2.0;
+  constexpr std::size_t groupsNumber = 100;
+  int nbAccepts = 0;
+  AcceptCountingTask bigTasks[groupsNumber];
+  WorkloadManager::FairShareAlgorithm fullAlgo;
+  fullAlgo.addResource(bigResource);
+  for(std::size_t i = 0; i < groupsNumber; i++)
+  {
+    bigTasks[i].reset(&bigType, i, 0, &mutex, &launchCounter);
+    bigTasks[i].setAcceptCounter(&nbAccepts);
+    fullAlgo.addTask(&bigTasks[i]);
+  }
+  CPPUNIT_ASSERT(fullAlgo.chooseTask().taskFound);
+  // 1 free core
+  nbAccepts = 0;
+  CPPUNIT_ASSERT(!fullAlgo.chooseTask().taskFound);
+  CPPUNIT_ASSERT(nbAccepts == 0);
+  // the groups of the big tasks are skipped
+  AcceptCountingTask smallTask;
+  smallTask.reset(&ctype, groupsNumber, 0, &mutex, &launchCounter);
+  smallTask.setAcceptCounter(&nbAccepts);
+  fullAlgo.addTask(&smallTask);
+  CPPUNIT_ASSERT(fullAlgo.chooseTask().task == &smallTask);
+  CPPUNIT_ASSERT(nbAccepts == 1);
+  CPPUNIT_ASSERT(!fullAlgo.chooseTask().taskFound);
+  CPPUNIT_ASSERT(nbAccepts == 1);
+}
+
+/**
+ * Two managers run at the same time on the same resource. The resource must
+ * never be oversubscribed and it must be fully used.
+ */
+void MyTest::brokerTest()
+{
+  WorkloadManager::Resource resource;
+  resource.nbCores = 4;
+  resource.name = "r0";
+  WorkloadManager::ContainerType ctype;
+  ctype.neededCores = 1.0;
+  ctype.name = "t0";
+
+  constexpr std::size_t tasksNumber = 20;
+  std::mutex mutex;
+  float usedCores = 0;
+  float maxUsedCores = 0;
+  int maxIndex = 0;
+  CountingTask tasks[2][tasksNumber];
+  for(std::size_t i = 0; i < 2; i++)
+    for(std::size_t j = 0; j < tasksNumber; j++)
+      tasks[i][j].reset(&ctype, 100, &mutex, &usedCores, &maxUsedCores,
+                        &maxIndex);
+
+  WorkloadManager::ResourceBroker broker;
+  WorkloadManager::DefaultAlgorithm algo1(broker);
+  WorkloadManager::DefaultAlgorithm algo2(broker);
+  WorkloadManager::WorkloadManager wlm1(algo1);
+  WorkloadManager::WorkloadManager wlm2(algo2);
+  wlm1.addResource(resource);
+  wlm2.addResource(resource);
+  for(std::size_t j = 0; j < tasksNumber; j++)
+  {
+    wlm1.addTask(&tasks[0][j]);
+    wlm2.addTask(&tasks[1][j]);
+  }
+  std::chrono::steady_clock::time_point start_time;
+  start_time = std::chrono::steady_clock::now();
+  wlm1.start();
+  wlm2.start();
+  wlm1.stop();
+  wlm2.stop();
+  std::chrono::milliseconds duration;
+  duration = std::chrono::duration_cast<std::chrono::milliseconds>
+             (std::chrono::steady_clock::now() - start_time);
+  DEBUG_LOG("Max used cores: ", maxUsedCores, ", duration: ",
+            duration.count(), "ms");
+  CPPUNIT_ASSERT(maxUsedCores <= resource.nbCores);
+  CPPUNIT_ASSERT(maxIndex < int(resource.nbCores));
+  // 40 tasks of 100ms on 4 cores
+  CPPUNIT_ASSERT(duration < std::chrono::milliseconds(1500));
+}
+
+/**
+ * Run 4 tasks of 1 core on 2 resources of 4 cores. They are spread on both
+ * resources with SpreadAlgorithm and packed on one resource with
+ * PackAlgorithm. With AffinityAlgorithm, the tasks go to the resource of
+ * their data, if any.
+ * The manager is instantiated on the algorithm, without virtual calls.
+ */
+template <class Algorithm>
+void runPlacement(int& nbTasksOnResource0,
+                  const std::string& dataResource = std::string())
+{
+  constexpr std::size_t resourcesNumber = 2;
+  WorkloadManager::Resource resources[resourcesNumber];
+  for(std::size_t i = 0; i < resourcesNumber; i++)
+  {
+    resources[i].id = i;
+    resources[i].name = "r" + std::to_string(i);
+    resources[i].nbCores = 4;
+  }
+  WorkloadManager::ContainerType ctype;
+  ctype.neededCores = 1.0;
+
+  constexpr std::size_t tasksNumber = 4;
+  LocalTask tasks[tasksNumber];
+  Algorithm algo;
+  WorkloadManager::BasicWorkloadManager<Algorithm> wlm(algo);
+  for(std::size_t i = 0; i < resourcesNumber; i++)
+    wlm.addResource(resources[i]);
+  WorkloadManager::LocalityHint hint;
+  hint.resourceName = dataResource;
+  for(std::size_t i = 0; i < tasksNumber; i++)
+  {
+    tasks[i].reset(&ctype, 100);
+    if(!dataResource.empty())
+      tasks[i].setHint(hint);
+    wlm.addTask(&tasks[i]);
+  }
+  wlm.start();
+  wlm.stop();
+  nbTasksOnResource0 = 0;
+  for(std::size_t i = 0; i < tasksNumber; i++)
+    if(tasks[i].resourceId() == 0)
+      nbTasksOnResource0++;
+}
+
+void MyTest::placementTest()
+{
+  int nbTasksOnResource0 = 0;
+  runPlacement<WorkloadManager::SpreadAlgorithm>(nbTasksOnResource0);
+  CPPUNIT_ASSERT(nbTasksOnResource0 == 2);
+  runPlacement<WorkloadManager::PackAlgorithm>(nbTasksOnResource0);
+  CPPUNIT_ASSERT(nbTasksOnResource0 == 4);
+  runPlacement<WorkloadManager::AffinityAlgorithm>(nbTasksOnResource0, "r1");
+  CPPUNIT_ASSERT(nbTasksOnResource0 == 0);
+  runPlacement<WorkloadManager::AffinityAlgorithm>(nbTasksOnResource0);
+  CPPUNIT_ASSERT(nbTasksOnResource0 == 2);
+}
+
+/**
+ * The number of waiting tasks is limited. The producer is blocked until
+ * the tasks are launched.
+ */
+void MyTest::admissionTest()
+{
+  WorkloadManager::Resource resource;
+  resource.nbCores = 2;
+  WorkloadManager::ContainerType ctype;
+  ctype.neededCores = 1.0;
+  WorkloadManager::ContainerType otherType;
+  otherType.neededCores = 1.0;
+  otherType.id = 1;
+
+  constexpr std::size_t tasksNumber = 20;
+  PlacedTask tasks[tasksNumber];
+  for(std::size_t i = 0; i < tasksNumber; i++)
+    tasks[i].reset(&ctype, 20);
+  PlacedTask otherTask;
+  otherTask.reset(&otherType, 20);
+
+  WorkloadManager::DefaultAlgorithm algo;
+  WorkloadManager::WorkloadManager wlm(algo);
+  wlm.addResource(resource);
+  wlm.setMaxQueuedTasks(3);
+  wlm.setMaxQueuedTasks(ctype, 2);
+  std::vector<bool> watermarkEvents;
+  wlm.setWatermarks(3, 0, [&watermarkEvents](bool above)
+    {
+      watermarkEvents.push_back(above);
+    });
+
+  // not started, the queue is full
+  CPPUNIT_ASSERT(wlm.tryAddTask(&tasks[0]));
+  CPPUNIT_ASSERT(wlm.tryAddTask(&tasks[1]));
+  CPPUNIT_ASSERT(!wlm.tryAddTask(&tasks[2])); // limit of the type
+  CPPUNIT_ASSERT(wlm.tryAddTask(&otherTask));
+  CPPUNIT_ASSERT(!wlm.addTask(&tasks[2], std::chrono::milliseconds(10)));
+  CPPUNIT_ASSERT(watermarkEvents.size() == 1 && watermarkEvents[0]);
+
+  // a task taken back frees its place
+  CPPUNIT_ASSERT(wlm.takeWaitingTask([&tasks](WorkloadManager::Task* t)
+                                     {
+                                       return t == &tasks[1];
+                                     }) == &tasks[1]);
+  CPPUNIT_ASSERT(wlm.tryAddTask(&tasks[1]));
+
+  wlm.start();
+  for(std::size_t i = 2; i < tasksNumber; i++)
+    wlm.addTask(&tasks[i]); // blocked while the queue is full
+  wlm.stop();
+  for(std::size_t i = 0; i < tasksNumber; i++)
+    CPPUNIT_ASSERT(tasks[i].resourceId() == 0);
+  CPPUNIT_ASSERT(otherTask.resourceId() == 0);
+  CPPUNIT_ASSERT(watermarkEvents.size() >= 2);
+  CPPUNIT_ASSERT(!watermarkEvents.back());
+
+  // no watermark
+  watermarkEvents.clear();
+  wlm.setWatermarks(0, 0, [&watermarkEvents](bool above)
+    {
+      watermarkEvents.push_back(above);
+    });
+  tasks[0].reset(&ctype, 0);
+  wlm.addTask(&tasks[0]);
+  wlm.start();
+  wlm.stop();
+  CPPUNIT_ASSERT(watermarkEvents.empty());
+}
+
+/**
+ * A gang task needs all the cores of 2 resources. It is added when the
+ * resources are busy with small tasks, which must not delay it forever.
+ * The gang tasks are supported by all the algorithms.
+ */
+void MyTest::gangTest()
+{
+  constexpr std::size_t resourcesNumber = 2;
+  WorkloadManager::Resource resources[resourcesNumber];
+  for(std::size_t i = 0; i < resourcesNumber; i++)
+  {
+    resources[i].id = i;
+    resources[i].nbCores = 4;
+  }
+  WorkloadManager::ContainerType smallType;
+  smallType.neededCores = 1.0;
+  WorkloadManager::ContainerType gangType;
+  gangType.id = 1;
+  gangType.neededCores = 4.0;
+  gangType.gangSize = 2;
+
+  constexpr std::size_t tasksNumber = 40;
+  std::mutex mutex;
+  int launchCounter = 0;
+  OrderedTask smallTasks[tasksNumber];
+  for(std::size_t i = 0; i < tasksNumber; i++)
+    smallTasks[i].reset(&smallType, 0, 50, &mutex, &launchCounter);
+  GangTask gangTask;
+  gangTask.reset(&gangType, 10, &mutex, &launchCounter);
+  // smaller gang task, which cannot use the resources reserved for gangTask
+  WorkloadManager::ContainerType smallGangType;
+  smallGangType.id = 2;
+  smallGangType.neededCores = 1.0;
+  smallGangType.gangSize = 2;
+  GangTask smallGangTask;
+  smallGangTask.reset(&smallGangType, 10, &mutex, &launchCounter);
+
+  WorkloadManager::DefaultAlgorithm algo;
+  WorkloadManager::WorkloadManager wlm(algo);
+  for(std::size_t i = 0; i < resourcesNumber; i++)
+    wlm.addResource(resources[i]);
+  for(std::size_t i = 0; i < tasksNumber; i++)
+    wlm.addTask(&smallTasks[i]);
+  wlm.start();
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  wlm.addTask(&gangTask);
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  wlm.addTask(&smallGangTask);
+  wlm.stop();
+
+  DEBUG_LOG("Gang task launch order: ", gangTask.launchOrder());
+  CPPUNIT_ASSERT(smallGangTask.launchOrder() > gangTask.launchOrder());
+  CPPUNIT_ASSERT(gangTask.launchOrder() >= 0);
+  CPPUNIT_ASSERT(gangTask.launchOrder() < 20);
+  CPPUNIT_ASSERT(gangTask.resourceIds().size() == 2);
+  CPPUNIT_ASSERT(gangTask.resourceIds()[0] != gangTask.resourceIds()[1]);
+
+  // The other algorithms launch all the containers of a gang task, after
+  // the small tasks if there are not enough free cores.
+  WorkloadManager::ContainerType mpiType;
+  mpiType.id = 3;
+  mpiType.neededCores = 2.0;
+  mpiType.gangSize = 3;
+  WorkloadManager::FairShareAlgorithm fairShareAlgo;
+  WorkloadManager::SpreadAlgorithm spreadAlgo;
+  WorkloadManager::PackAlgorithm packAlgo;
+  WorkloadManager::WorkloadAlgorithm* algorithms[] = {&fairShareAlgo,
+                                                      &spreadAlgo,
+                                                      &packAlgo};
+  for(WorkloadManager::WorkloadAlgorithm* otherAlgo : algorithms)
+  {
+    launchCounter = 0;
+    for(std::size_t i = 0; i < 4; i++)
+      smallTasks[i].reset(&smallType, 0, 20, &mutex, &launchCounter);
+    gangTask.reset(&mpiType, 10, &mutex, &launchCounter);
+    WorkloadManager::WorkloadManager otherWlm(*otherAlgo);
+    for(std::size_t i = 0; i < resourcesNumber; i++)
+      otherWlm.addResource(resources[i]);
+    for(std::size_t i = 0; i < 4; i++)
+      otherWlm.addTask(&smallTasks[i]);
+    otherWlm.addTask(&gangTask);
+    otherWlm.start();
+    otherWlm.stop();
+    CPPUNIT_ASSERT(gangTask.launchOrder() >= 0);
+    CPPUNIT_ASSERT(gangTask.resourceIds().size() == 3);
+  }
+}
+
+/**
+ * Short tasks are run by batches of 5 in the same thread and container.
+ * Then adaptive batches are used.
+ */
+void MyTest::batchTest()
+{
+  WorkloadManager::Resource resource;
+  resource.nbCores = 2;
+  WorkloadManager::ContainerType ctype;
+  ctype.neededCores = 1.0;
+
+  constexpr std::size_t batchSize = 5;
+  constexpr std::size_t tasksNumber = 4 * batchSize;
+  BatchedTask tasks[tasksNumber];
+  for(std::size_t i = 0; i < tasksNumber; i++)
+    tasks[i].reset(&ctype, 1);
+
+  WorkloadManager::DefaultAlgorithm algo;
+  WorkloadManager::WorkloadManager wlm(algo);
+  wlm.addResource(resource);
+  wlm.setBatchSize(batchSize);
+  for(std::size_t i = 0; i < tasksNumber; i++)
+    wlm.addTask(&tasks[i]);
+  wlm.start();
+  wlm.stop();
+  for(std::size_t i = 0; i < tasksNumber; i++)
+  {
+    std::size_t first = i - i % batchSize;
+    CPPUNIT_ASSERT(tasks[i].index() >= 0);
+    CPPUNIT_ASSERT(tasks[i].threadId() == tasks[first].threadId());
+    CPPUNIT_ASSERT(tasks[i].index() == tasks[first].index());
+  }
+
+  // The first task of the type is run alone, then the batches last about
+  // 50ms.
+  wlm.setAdaptiveBatching(std::chrono::milliseconds(50), 10);
+  for(std::size_t i = 0; i < tasksNumber; i++)
+  {
+    tasks[i].reset(&ctype, 10);
+    wlm.addTask(&tasks[i]);
+  }
+  std::chrono::steady_clock::time_point start_time;
+  start_time = std::chrono::steady_clock::now();
+  wlm.start();
+  wlm.stop();
+  std::chrono::milliseconds duration;
+  duration = std::chrono::duration_cast<std::chrono::milliseconds>
+             (std::chrono::steady_clock::now() - start_time);
+  for(std::size_t i = 0; i < tasksNumber; i++)
+    CPPUNIT_ASSERT(tasks[i].index() >= 0);
+  // 20 tasks of 10ms on 2 cores.
+  CPPUNIT_ASSERT(duration < std::chrono::milliseconds(300));
+}
+
+/**
+ * The tasks are run by a worker agent in a child process. The agent returns
+ * the container index as the status of the tasks. The crash of the agent
+ * does not stop the manager.
+ */
+void MyTest::agentTest()
+{
+  std::ostringstream socketPath;
+  socketPath << "/tmp/wlm_test_" << getpid() << ".sock";
+  pid_t agentPid = fork();
+  if(agentPid == 0)
+  {
+    WorkloadManager::WorkerAgent agent(socketPath.str(), "r0",
+      [](unsigned int index, const std::string& descriptor)
+      {
+        if(descriptor == "crash")
+          _exit(1);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        return int(index);
+      });
+    // wait for the server
+    for(int i = 0; i < 100 && !agent.run(); i++)
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    _exit(0);
+  }
+  CPPUNIT_ASSERT(agentPid > 0);
+
+  WorkloadManager::AgentServer server(socketPath.str());
+  CPPUNIT_ASSERT(server.waitAgent("r0", std::chrono::seconds(5)));
+  WorkloadManager::Resource resource;
+  resource.nbCores = 2;
+  resource.name = "r0";
+  WorkloadManager::ContainerType ctype;
+  ctype.neededCores = 1.0;
+
+  constexpr std::size_t tasksNumber = 10;
+  std::vector<MyRemoteTask> tasks(tasksNumber, MyRemoteTask(server));
+  for(std::size_t i = 0; i < tasksNumber; i++)
+    tasks[i].reset(&ctype, "run");
+  WorkloadManager::DefaultAlgorithm algo;
+  WorkloadManager::WorkloadManager wlm(algo);
+  wlm.addResource(resource);
+  for(std::size_t i = 0; i < tasksNumber; i++)
+    wlm.addTask(&tasks[i]);
+  wlm.start();
+  wlm.stop();
+  for(std::size_t i = 0; i < tasksNumber; i++)
+    CPPUNIT_ASSERT(tasks[i].status() == 0 || tasks[i].status() == 1);
+
+  MyRemoteTask crashTask(server);
+  crashTask.reset(&ctype, "crash");
+  wlm.addTask(&crashTask);
+  wlm.start();
+  wlm.stop();
+  CPPUNIT_ASSERT(crashTask.status() == WorkloadManager::AgentServer::AGENT_LOST);
+  int agentStatus = 0;
+  CPPUNIT_ASSERT(waitpid(agentPid, &agentStatus, 0) == agentPid);
+
+  // no more agent for the resource
+  tasks[0].reset(&ctype, "run");
+  wlm.addTask(&tasks[0]);
+  wlm.start();
+  wlm.stop();
+  CPPUNIT_ASSERT(tasks[0].status() == WorkloadManager::AgentServer::NO_AGENT);
+}
+
+/**
+ * 4 tasks of 1 core have their data on r1. There are 2 resources of 2 cores.
+ * Without delay, 2 tasks go to r1 and 2 tasks go to r0. With a delay, all
+ * the tasks wait for r1.
+ */
+void MyTest::localityTest()
+{
+  constexpr std::size_t resourcesNumber = 2;
+  WorkloadManager::Resource resources[resourcesNumber];
+  for(std::size_t i = 0; i < resourcesNumber; i++)
+  {
+    resources[i].id = i;
+    resources[i].nbCores = 2;
+    std::ostringstream name;
+    name << "r" << i;
+    resources[i].name = name.str();
+  }
+  WorkloadManager::ContainerType ctype;
+  ctype.neededCores = 1.0;
+  WorkloadManager::LocalityHint hint;
+  hint.resourceName = "r1";
+
+  constexpr std::size_t tasksNumber = 4;
+  LocalTask tasks[tasksNumber];
+  WorkloadManager::DefaultAlgorithm algo;
+  WorkloadManager::WorkloadManager wlm(algo);
+  for(std::size_t i = 0; i < resourcesNumber; i++)
+    wlm.addResource(resources[i]);
+  for(std::size_t i = 0; i < tasksNumber; i++)
+  {
+    tasks[i].reset(&ctype, 100);
+    tasks[i].setHint(hint);
+    wlm.addTask(&tasks[i]);
+  }
+  wlm.start();
+  wlm.stop();
+  int nbTasksOnResource1 = 0;
+  for(std::size_t i = 0; i < tasksNumber; i++)
+    if(tasks[i].resourceId() == 1)
+      nbTasksOnResource1++;
+  CPPUNIT_ASSERT(nbTasksOnResource1 == 2);
+
+  // same thing with a data set and a delay
+  wlm.setLocalityDelay(std::chrono::milliseconds(1000));
+  wlm.setDataSetLocation("data1", "r1");
+  hint.resourceName.clear();
+  hint.dataSet = "data1";
+  for(std::size_t i = 0; i < tasksNumber; i++)
+  {
+    tasks[i].reset(&ctype, 100);
+    tasks[i].setHint(hint);
+    wlm.addTask(&tasks[i]);
+  }
+  wlm.start();
+  wlm.stop();
+  for(std::size_t i = 0; i < tasksNumber; i++)
+    CPPUNIT_ASSERT(tasks[i].resourceId() == 1);
+
+  // The delay is over before r1 is free.
+  wlm.setLocalityDelay(std::chrono::milliseconds(20));
+  for(std::size_t i = 0; i < tasksNumber; i++)
+  {
+    tasks[i].reset(&ctype, 100);
+    wlm.addTask(&tasks[i]);
+  }
+  wlm.start();
+  wlm.stop();
+  nbTasksOnResource1 = 0;
+  for(std::size_t i = 0; i < tasksNumber; i++)
+    if(tasks[i].resourceId() == 1)
+      nbTasksOnResource1++;
+  CPPUNIT_ASSERT(nbTasksOnResource1 == 2);
+
+  // The batches keep the locality: 2 tasks with data on r0 and 2 tasks
+  // with data on r1.
+  WorkloadManager::DefaultAlgorithm batchAlgo;
+  WorkloadManager::WorkloadManager batchWlm(batchAlgo);
+  for(std::size_t i = 0; i < resourcesNumber; i++)
+  {
+    resources[i].nbCores = 1;
+    batchWlm.addResource(resources[i]);
+  }
+  batchWlm.setBatchSize(tasksNumber);
+  for(std::size_t i = 0; i < tasksNumber; i++)
+  {
+    hint.dataSet.clear();
+    hint.resourceName = i < 2 ? "r0" : "r1";
+    tasks[i].reset(&ctype, 10);
+    tasks[i].setHint(hint);
+    batchWlm.addTask(&tasks[i]);
+  }
+  batchWlm.start();
+  batchWlm.stop();
+  for(std::size_t i = 0; i < tasksNumber; i++)
+    CPPUNIT_ASSERT(tasks[i].resourceId() == (i < 2 ? 0 : 1));
+}
+
+/**
+ * 4 tasks of 1 core are launched on 3 resources of 4 cores, then comes a
+ * task of 4 cores. In the pack mode, the small tasks are on the same
+ * resource and the big task is launched at once. In the spread mode, it has
+ * to wait for the end of the small tasks.
+ */
+void MyTest::consolidationTest()
+{
+  constexpr std::size_t resourcesNumber = 3;
+  WorkloadManager::Resource resources[resourcesNumber];
+  for(std::size_t i = 0; i < resourcesNumber; i++)
+  {
+    resources[i].id = i;
+    resources[i].nbCores = 4;
+    std::ostringstream name;
+    name << "r" << i;
+    resources[i].name = name.str();
+  }
+  WorkloadManager::ContainerType smallType;
+  smallType.neededCores = 1.0;
+  WorkloadManager::ContainerType bigType;
+  bigType.neededCores = 4.0;
+  bigType.id = 1;
+
+  constexpr std::size_t tasksNumber = 4;
+  PlacedTask tasks[tasksNumber];
+  PlacedTask bigTask;
+  WorkloadManager::DefaultAlgorithm algo;
+  WorkloadManager::WorkloadManager wlm(algo);
+  for(std::size_t i = 0; i < resourcesNumber; i++)
+    wlm.addResource(resources[i]);
+
+  for(WorkloadManager::DefaultAlgorithm::PlacementMode mode :
+      {WorkloadManager::DefaultAlgorithm::PACK,
+       WorkloadManager::DefaultAlgorithm::SPREAD})
+  {
+    wlm.setPlacementMode(mode);
+    wlm.start();
+    for(std::size_t i = 0; i < tasksNumber; i++)
+    {
+      tasks[i].reset(&smallType, 300);
+      wlm.addTask(&tasks[i]);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    bigTask.reset(&bigType, 10);
+    wlm.addTask(&bigTask);
+    bool bigTaskStarted = wlm.wait(&bigTask, std::chrono::milliseconds(100));
+    wlm.stop();
+    if(mode == WorkloadManager::DefaultAlgorithm::PACK)
+    {
+      CPPUNIT_ASSERT(bigTaskStarted);
+      for(std::size_t i = 0; i < tasksNumber; i++)
+        CPPUNIT_ASSERT(tasks[i].resourceId() == 0);
+      CPPUNIT_ASSERT(bigTask.resourceId() != 0);
+    }
+    else
+      CPPUNIT_ASSERT(!bigTaskStarted);
+  }
+}
+
+/**
+ * 2 shards of 1 resource of 1 core. A long task can only run on r0, and 6
+ * short tasks can run anywhere. The router sends 3 short tasks to each
+ * shard, then the shard of r1 takes the short tasks which wait for r0.
+ * A task which can run on no resource is rejected.
+ */
+void MyTest::shardTest()
+{
+  constexpr std::size_t resourcesNumber = 2;
+  WorkloadManager::ShardedManager manager(resourcesNumber);
+  for(std::size_t i = 0; i < resourcesNumber; i++)
+  {
+    WorkloadManager::Resource resource;
+    resource.id = i;
+    resource.nbCores = 1;
+    manager.addResource(resource);
+  }
+  WorkloadManager::ContainerType ctype;
+  ctype.neededCores = 1.0;
+
+  PinnedTask longTask;
+  longTask.reset(&ctype, 300);
+  longTask.setAcceptedResource(0);
+  manager.addTask(&longTask);
+  constexpr std::size_t tasksNumber = 6;
+  PinnedTask tasks[tasksNumber];
+  for(std::size_t i = 0; i < tasksNumber; i++)
+  {
+    tasks[i].reset(&ctype, 20);
+    manager.addTask(&tasks[i]);
+  }
+  // no shard can run it
+  PinnedTask lostTask;
+  lostTask.reset(&ctype, 20);
+  lostTask.setAcceptedResource(2);
+  CPPUNIT_ASSERT(!manager.addTask(&lostTask));
+  manager.start();
+  manager.stop();
+  CPPUNIT_ASSERT(longTask.resourceId() == 0);
+  for(std::size_t i = 0; i < tasksNumber; i++)
+    CPPUNIT_ASSERT(tasks[i].resourceId() == 1);
+}
+
+/**
+ * Topology read from sysfs files, containers of 2 cores pinned to the CPUs
+ * of a NUMA node of 2 CPUs, and affinity of the threads of the tasks.
+ * The topology cannot change while a container is running.
+ */
+void MyTest::pinningTest()
+{
+  std::vector<int> expected = {0, 1, 2, 3, 8, 10, 11};
+  CPPUNIT_ASSERT(WorkloadManager::CpuTopology::parseCpuList("0-3,8,10-11")
+                 == expected);
+
+  char nodesPath[] = "/tmp/wlmnodesXXXXXX";
+  CPPUNIT_ASSERT(mkdtemp(nodesPath) != nullptr);
+  std::string nodes = nodesPath;
+  mkdir((nodes + "/node1").c_str(), 0700);
+  mkdir((nodes + "/node0").c_str(), 0700);
+  std::ofstream(nodes + "/node0/cpulist") << "0-1" << std::endl;
+  std::ofstream(nodes + "/node1/cpulist") << "2-3" << std::endl;
+  WorkloadManager::CpuTopology topology;
+  // all the CPUs of the nodes are allowed
+  topology = WorkloadManager::CpuTopology::local(nodes, {0, 1, 2, 3});
+  WorkloadManager::CpuTopology restricted;
+  restricted = WorkloadManager::CpuTopology::local(nodes, {2, 3, 5});
+  std::remove((nodes + "/node0/cpulist").c_str());
+  std::remove((nodes + "/node1/cpulist").c_str());
+  rmdir((nodes + "/node0").c_str());
+  rmdir((nodes + "/node1").c_str());
+  rmdir(nodesPath);
+  CPPUNIT_ASSERT(topology.nodes().size() == 2);
+  CPPUNIT_ASSERT(topology.nodes()[1] == std::vector<int>({2, 3}));
+  CPPUNIT_ASSERT(restricted.nodes().size() == 1);
+  CPPUNIT_ASSERT(restricted.nodes()[0] == std::vector<int>({2, 3}));
+
+  WorkloadManager::Resource resource;
+  resource.nbCores = 4;
+  resource.name = "localhost";
+  WorkloadManager::ContainerType ctype;
+  ctype.neededCores = 2.0;
+  constexpr std::size_t tasksNumber = 6;
+  CpuTask tasks[tasksNumber];
+  {
+    WorkloadManager::DefaultAlgorithm algo;
+    WorkloadManager::WorkloadManager wlm(algo);
+    wlm.addResource(resource);
+    CPPUNIT_ASSERT(wlm.setCpuTopology("localhost", topology));
+    for(std::size_t i = 0; i < tasksNumber; i++)
+    {
+      tasks[i].reset(&ctype, 20);
+      wlm.addTask(&tasks[i]);
+    }
+    wlm.start();
+    wlm.stop();
+  }
+  std::vector<int> cpusOfIndex[2];
+  for(std::size_t i = 0; i < tasksNumber; i++)
+  {
+    const std::vector<int>& cpus = tasks[i].cpus();
+    CPPUNIT_ASSERT(cpus == topology.nodes()[0] || cpus == topology.nodes()[1]);
+    // a container keeps its CPUs
+    CPPUNIT_ASSERT(tasks[i].index() < 2);
+    std::vector<int>& previous = cpusOfIndex[tasks[i].index()];
+    CPPUNIT_ASSERT(previous.empty() || previous == cpus);
+    previous = cpus;
+  }
+  CPPUNIT_ASSERT(cpusOfIndex[0] != cpusOfIndex[1]);
+
+  // Affinity on the CPUs of this machine
+  resource.nbCores = 1;
+  ctype.neededCores = 1.0;
+  WorkloadManager::DefaultAlgorithm algo;
+  WorkloadManager::WorkloadManager wlm(algo);
+  wlm.addResource(resource);
+  wlm.setCpuTopology("localhost", WorkloadManager::CpuTopology::local());
+  tasks[0].reset(&ctype, 0);
+  wlm.addTask(&tasks[0]);
+  wlm.start();
+  wlm.stop();
+  CPPUNIT_ASSERT(tasks[0].cpus().size() == 1);
+  CPPUNIT_ASSERT(tasks[0].affinity() == tasks[0].cpus());
+  CPPUNIT_ASSERT(wlm.nbPinningFailures() == 0);
+  // the scheduler threads are still running
+  CPPUNIT_ASSERT(wlm.setCpuTopology("localhost", topology));
+
+  // no new topology while a container is running
+  WorkloadManager::DefaultAlgorithm busyAlgo;
+  busyAlgo.addResource(resource);
+  busyAlgo.addTask(&tasks[1]);
+  WorkloadManager::WorkloadAlgorithm::LaunchInfo launched;
+  launched = busyAlgo.chooseTask();
+  CPPUNIT_ASSERT(launched.taskFound);
+  CPPUNIT_ASSERT(!busyAlgo.setCpuTopology("localhost", topology));
+  busyAlgo.liberate(launched);
+  CPPUNIT_ASSERT(busyAlgo.setCpuTopology("localhost", topology));
+}
+
+/**
+ * 3 tasks are completed and 2 tasks are still waiting when the manager is
+ * destroyed. A new manager with the same journal runs the 2 waiting tasks.
+ * The journal is compacted when most of its records are obsolete.
+ * A record which cannot be written does not change the pending tasks.
+ */
+void MyTest::journalTest()
+{
+  char journalPath[] = "/tmp/wlmjournalXXXXXX";
+  int fd = mkstemp(journalPath);
+  CPPUNIT_ASSERT(fd >= 0);
+  close(fd);
+  std::remove(journalPath);
+
+  WorkloadManager::Resource resource;
+  resource.nbCores = 2;
+  WorkloadManager::ContainerType ctype;
+  ctype.neededCores = 1.0;
+  constexpr std::size_t tasksNumber = 5;
+  KeyedTask tasks[tasksNumber];
+  for(std::size_t i = 0; i < tasksNumber; i++)
+  {
+    tasks[i].reset(&ctype, 0);
+    tasks[i].setKey("task" + std::to_string(i));
+  }
+  {
+    WorkloadManager::TaskJournal journal(journalPath);
+    WorkloadManager::DefaultAlgorithm algo;
+    WorkloadManager::WorkloadManager wlm(algo);
+    wlm.addResource(resource);
+    wlm.setJournal(&journal);
+    for(std::size_t i = 0; i < 3; i++)
+      wlm.addTask(&tasks[i]);
+    wlm.start();
+    wlm.stop();
+    // not run before the "crash"
+    wlm.addTask(&tasks[3]);
+    wlm.addTask(&tasks[4]);
+  }
+  for(std::size_t i = 0; i < tasksNumber; i++)
+    tasks[i].reset(&ctype, 0);
+  {
+    WorkloadManager::TaskJournal journal(journalPath);
+    std::vector<std::string> expected = {"task3", "task4"};
+    CPPUNIT_ASSERT(journal.pendingKeys() == expected);
+    WorkloadManager::DefaultAlgorithm algo;
+    WorkloadManager::WorkloadManager wlm(algo);
+    wlm.addResource(resource);
+    wlm.setJournal(&journal);
+    std::size_t nbRecovered = wlm.recoverTasks(
+      [&tasks](const std::string& key) -> WorkloadManager::Task*
+      {
+        for(KeyedTask& task : tasks)
+          if(task.key() == key)
+            return &task;
+        return nullptr;
+      });
+    CPPUNIT_ASSERT(nbRecovered == 2);
+    wlm.start();
+    wlm.stop();
+    CPPUNIT_ASSERT(journal.pendingKeys().empty());
+  }
+  for(std::size_t i = 0; i < 3; i++)
+    CPPUNIT_ASSERT(tasks[i].resourceId() == -1);
+  for(std::size_t i = 3; i < tasksNumber; i++)
+    CPPUNIT_ASSERT(tasks[i].resourceId() == 0);
+
+  {
+    WorkloadManager::TaskJournal journal(journalPath);
+    journal.recordSubmitted("long");
+    for(int i = 0; i < 10000; i++)
+    {
+      std::string key = "short" + std::to_string(i);
+      journal.recordSubmitted(key);
+      journal.recordCompleted(key);
+      if(journal.needsCompaction())
+        CPPUNIT_ASSERT(journal.compact());
+    }
+    CPPUNIT_ASSERT(journal.nbRecords() < 2000);
+  }
+  {
+    WorkloadManager::TaskJournal journal(journalPath);
+    CPPUNIT_ASSERT(journal.pendingKeys()
+                   == std::vector<std::string>({"long"}));
+    // records added during a compaction
+    WorkloadManager::TaskJournal::Compaction compaction;
+    journal.beginCompaction(compaction);
+    journal.writeCompaction(compaction);
+    journal.recordSubmitted("late");
+    journal.recordCompleted("long");
+    CPPUNIT_ASSERT(journal.endCompaction(compaction));
+    CPPUNIT_ASSERT(journal.nbRecords() == 3);
+  }
+  {
+    WorkloadManager::TaskJournal journal(journalPath);
+    CPPUNIT_ASSERT(journal.pendingKeys()
+                   == std::vector<std::string>({"late"}));
+    journal.recordCompleted("late");
+  }
+
+  // compacted by the manager
+  {
+    WorkloadManager::TaskJournal journal(journalPath);
+    {
+      WorkloadManager::DefaultAlgorithm algo;
+      WorkloadManager::WorkloadManager wlm(algo);
+      wlm.addResource(resource);
+      wlm.setJournal(&journal);
+      wlm.start();
+      KeyedTask task;
+      task.reset(&ctype, 0);
+      for(int i = 0; i < 600; i++)
+      {
+        task.setKey("managed" + std::to_string(i));
+        wlm.addTask(&task);
+        wlm.wait(&task);
+      }
+    }
+    CPPUNIT_ASSERT(journal.pendingKeys().empty());
+    CPPUNIT_ASSERT(journal.nbRecords() < 1200);
+  }
+
+  // A submission which cannot be written is not pending.
+  std::remove(journalPath);
+  std::size_t nbSubmitted = 0;
+  {
+    WorkloadManager::TaskJournal journal(journalPath);
+    rlimit oldLimit;
+    getrlimit(RLIMIT_FSIZE, &oldLimit);
+    rlimit limit = oldLimit;
+    limit.rlim_cur = 1 << 20; // the initial size of the journal
+    void (*oldHandler)(int) = std::signal(SIGXFSZ, SIG_IGN);
+    setrlimit(RLIMIT_FSIZE, &limit);
+    bool failed = false;
+    while(!failed)
+    {
+      std::string key = std::to_string(nbSubmitted) + std::string(1000, 'k');
+      try
+      {
+        journal.recordSubmitted(key);
+        nbSubmitted++;
+      }
+      catch(const std::runtime_error&)
+      {
+        failed = true;
+      }
+    }
+    setrlimit(RLIMIT_FSIZE, &oldLimit);
+    std::signal(SIGXFSZ, oldHandler);
+    CPPUNIT_ASSERT(journal.pendingKeys().size() == nbSubmitted);
+    CPPUNIT_ASSERT(journal.compact());
+  }
+  {
+    WorkloadManager::TaskJournal journal(journalPath);
+    CPPUNIT_ASSERT(nbSubmitted > 0);
+    CPPUNIT_ASSERT(journal.pendingKeys().size() == nbSubmitted);
+  }
+  std::remove(journalPath);
+}
+
+/**
+ * The manager keeps running between two phases. No task is launched while
+ * the manager is paused.
+ */
+void MyTest::lifecycleTest()
+{
+  WorkloadManager::Resource resource;
+  resource.nbCores = 2;
+  WorkloadManager::ContainerType ctype;
+  ctype.neededCores = 1.0;
+  constexpr std::size_t tasksNumber = 4;
+  PlacedTask tasks[tasksNumber];
+  WorkloadManager::DefaultAlgorithm algo;
+  WorkloadManager::WorkloadManager wlm(algo);
+  wlm.addResource(resource);
+  wlm.start();
+  for(int phase = 0; phase < 3; phase++)
+  {
+    for(std::size_t i = 0; i < tasksNumber; i++)
+    {
+      tasks[i].reset(&ctype, 10);
+      wlm.addTask(&tasks[i]);
+    }
+    wlm.waitAll();
+    for(std::size_t i = 0; i < tasksNumber; i++)
+      CPPUNIT_ASSERT(tasks[i].resourceId() == 0);
+  }
+
+  wlm.pause();
+  tasks[0].reset(&ctype, 10);
+  wlm.addTask(&tasks[0]);
+  CPPUNIT_ASSERT(!wlm.wait(&tasks[0], std::chrono::milliseconds(50)));
+  CPPUNIT_ASSERT(tasks[0].resourceId() == -1);
+  wlm.resume();
+  wlm.wait(&tasks[0]);
+  CPPUNIT_ASSERT(tasks[0].resourceId() == 0);
+  // not a task of this manager
+  wlm.wait(&tasks[1]);
+  wlm.stop();
+
+  // no launch between stop and start
+  tasks[0].reset(&ctype, 10);
+  wlm.addTask(&tasks[0]);
+  CPPUNIT_ASSERT(!wlm.wait(&tasks[0], std::chrono::milliseconds(50)));
+  wlm.start();
+  wlm.stop();
+  CPPUNIT_ASSERT(tasks[0].resourceId() == 0);
+}
+
+/**
+ * Equal types have the same handle, even if they are different objects.
+ * An object which is modified gets the handle of its new value.
+ */
+void MyTest::typeHandleTest()
+{
+  WorkloadManager::ResourcePool pool;
+  WorkloadManager::ContainerType ctype;
+  ctype.name = "a";
+  WorkloadManager::ContainerType sameType = ctype;
+  WorkloadManager::ContainerTypeHandle handle = pool.registerType(ctype);
+  CPPUNIT_ASSERT(pool.registerType(ctype) == handle);
+  CPPUNIT_ASSERT(pool.registerType(sameType) == handle);
+  ctype.name = "b";
+  WorkloadManager::ContainerTypeHandle otherHandle = pool.registerType(ctype);
+  CPPUNIT_ASSERT(otherHandle != handle);
+  CPPUNIT_ASSERT(pool.type(otherHandle)->name == "b");
+  CPPUNIT_ASSERT(pool.registerType(sameType) == handle);
+}
+
+/**
+ * The server closes the connection of an agent which sends a truncated or
+ * inconsistent DONE message, or a frame bigger than the limit.
+ */
+void MyTest::agentProtocolTest()
+{
+  std::string buffer;
+  WorkloadManager::AgentProtocol::MessageType type;
+  std::string payload;
+  WorkloadManager::AgentProtocol::putUInt32(buffer, 0xFFFFFFFF);
+  buffer.push_back(char(WorkloadManager::AgentProtocol::DONE));
+  CPPUNIT_ASSERT(WorkloadManager::AgentProtocol::extractFrame(buffer, type,
+                                                              payload)
+                 == WorkloadManager::AgentProtocol::FRAME_TOO_BIG);
+  buffer.clear();
+  WorkloadManager::AgentProtocol::appendFrame(buffer,
+                                     WorkloadManager::AgentProtocol::DONE,
+                                     "abc");
+  buffer.pop_back();
+  CPPUNIT_ASSERT(WorkloadManager::AgentProtocol::extractFrame(buffer, type,
+                                                              payload)
+                 == WorkloadManager::AgentProtocol::FRAME_INCOMPLETE);
+
+  std::ostringstream socketPath;
+  socketPath << "/tmp/wlm_protocol_" << getpid() << ".sock";
+  WorkloadManager::AgentServer server(socketPath.str());
+  std::vector<std::string> badFrames;
+  // truncated count
+  std::string frame;
+  WorkloadManager::AgentProtocol::appendFrame(frame,
+                                     WorkloadManager::AgentProtocol::DONE,
+                                     "ab");
+  badFrames.push_back(frame);
+  // count * 12 is 0 on 32 bits
+  std::string done;
+  WorkloadManager::AgentProtocol::putUInt32(done, 1u << 30);
+  frame.clear();
+  WorkloadManager::AgentProtocol::appendFrame(frame,
+                                     WorkloadManager::AgentProtocol::DONE,
+                                     done);
+  badFrames.push_back(frame);
+  // too big
+  frame.clear();
+  WorkloadManager::AgentProtocol::putUInt32(frame,
+                         WorkloadManager::AgentProtocol::MAX_PAYLOAD_SIZE + 1);
+  frame.push_back(char(WorkloadManager::AgentProtocol::DONE));
+  badFrames.push_back(frame);
+
+  for(const std::string& badFrame : badFrames)
+  {
+    int fd = WorkloadManager::AgentProtocol::connectTo(socketPath.str());
+    CPPUNIT_ASSERT(fd >= 0);
+    std::string message;
+    WorkloadManager::AgentProtocol::appendFrame(message,
+                                     WorkloadManager::AgentProtocol::REGISTER,
+                                     "r0");
+    message += badFrame;
+    CPPUNIT_ASSERT(WorkloadManager::AgentProtocol::writeAll(fd, message));
+    // closed by the server
+    pollfd pollFd = {fd, POLLIN, 0};
+    CPPUNIT_ASSERT(poll(&pollFd, 1, 5000) == 1);
+    char data[16];
+    CPPUNIT_ASSERT(read(fd, data, sizeof(data)) == 0);
+    close(fd);
+  }
+}
+
+/**
+ * Connect an agent which does not run the tasks, for agentLaunchTest.
+ */
+static int registerFakeAgent(const std::string& socketPath,
+                             const std::string& resourceName)
+{
+  int fd = WorkloadManager::AgentProtocol::connectTo(socketPath);
+  std::string message;
+  WorkloadManager::AgentProtocol::appendFrame(message,
+                                     WorkloadManager::AgentProtocol::REGISTER,
+                                     resourceName);
+  WorkloadManager::AgentProtocol::writeAll(fd, message);
+  return fd;
+}
+
+/**
+ * Id of the next launch received by a fake agent.
+ */
+static std::uint64_t receiveLaunch(int fd)
+{
+  std::string buffer;
+  WorkloadManager::AgentProtocol::MessageType type;
+  std::string payload;
+  while(WorkloadManager::AgentProtocol::extractFrame(buffer, type, payload)
+        != WorkloadManager::AgentProtocol::FRAME_OK)
+  {
+    char data[256];
+    ssize_t n = read(fd, data, sizeof(data));
+    if(n <= 0)
+      return -1;
+    buffer.append(data, n);
+  }
+  std::size_t pos = 0;
+  return WorkloadManager::AgentProtocol::getUInt64(payload, pos);
+}
+
+static void sendDone(int fd, std::uint64_t launchId, std::uint32_t status)
+{
+  std::string done;
+  WorkloadManager::AgentProtocol::putUInt32(done, 1);
+  WorkloadManager::AgentProtocol::putUInt64(done, launchId);
+  WorkloadManager::AgentProtocol::putUInt32(done, status);
+  std::string message;
+  WorkloadManager::AgentProtocol::appendFrame(message,
+                                     WorkloadManager::AgentProtocol::DONE,
+                                     done);
+  WorkloadManager::AgentProtocol::writeAll(fd, message);
+}
+
+/**
+ * A launch is only ended by the agent which runs it, or when the server is
+ * destroyed.
+ */
+void MyTest::agentLaunchTest()
+{
+  std::ostringstream socketPath;
+  socketPath << "/tmp/wlm_launch_" << getpid() << ".sock";
+  std::unique_ptr<WorkloadManager::AgentServer> server(
+                    new WorkloadManager::AgentServer(socketPath.str()));
+  int fd1 = registerFakeAgent(socketPath.str(), "r1");
+  int fd2 = registerFakeAgent(socketPath.str(), "r2");
+  CPPUNIT_ASSERT(fd1 >= 0 && fd2 >= 0);
+  CPPUNIT_ASSERT(server->waitAgent("r1", std::chrono::seconds(1)));
+  CPPUNIT_ASSERT(server->waitAgent("r2", std::chrono::seconds(1)));
+  WorkloadManager::Resource resource;
+  resource.name = "r1";
+  WorkloadManager::RunInfo worker;
+  worker.resource = &resource;
+  WorkloadManager::AgentServer* serverPtr = server.get();
+  std::future<int> status = std::async(std::launch::async,
+                                       [serverPtr, &worker]
+    {
+      return serverPtr->launch(worker, "task");
+    });
+  std::uint64_t launchId = receiveLaunch(fd1);
+  // not the agent of the launch
+  sendDone(fd2, launchId, 1);
+  CPPUNIT_ASSERT(status.wait_for(std::chrono::milliseconds(100))
+                 == std::future_status::timeout);
+  sendDone(fd1, launchId, 2);
+  CPPUNIT_ASSERT(status.get() == 2);
+
+  // The destructor waits for the launch, which is lost.
+  status = std::async(std::launch::async, [serverPtr, &worker]
+    {
+      return serverPtr->launch(worker, "task");
+    });
+  receiveLaunch(fd1);
+  server.reset();
+  CPPUNIT_ASSERT(status.wait_for(std::chrono::seconds(0))
+                 == std::future_status::ready);
+  CPPUNIT_ASSERT(status.get() == WorkloadManager::AgentServer::AGENT_LOST);
+  close(fd1);
+  close(fd2);
+}
+
 CPPUNIT_TEST_SUITE_REGISTRATION(MyTest);
 
 #include "BasicMainTest.hxx"
@@ -18,8 +18,8 @@ public:
   void run(const WorkloadManager::RunInfo& c)override 
   {
     std::ostringstream message;
-    message << "Running task on " << c.resource.name << "-"
-              << c.type.name << "-" << c.index << std::endl;
+    message << "Running task on " << c.resource->name << "-"
+              << c.type->name << "-" << c.index << std::endl;
     std::cout << message.str();
   }
   
@@ -0,0 +1,137 @@
+// Copyright (C) 2020  CEA/DEN, EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+#include "WorkerAgent.hxx"
+#include "AgentProtocol.hxx"
+#include <thread>
+#include <cerrno>
+#include <unistd.h>
+
+namespace WorkloadManager
+{
+WorkerAgent::WorkerAgent(const std::string& socketPath,
+                         const std::string& resourceName,
+                         const Handler& handler)
+: _socketPath(socketPath)
+, _resourceName(resourceName)
+, _handler(handler)
+, _mutex()
+, _condition()
+, _completions()
+, _runningTasks(0)
+, _stop(false)
+{
+}
+
+bool WorkerAgent::run()
+{
+  int fd = AgentProtocol::connectTo(_socketPath);
+  if(fd < 0)
+    return false;
+  std::string frame;
+  AgentProtocol::appendFrame(frame, AgentProtocol::REGISTER, _resourceName);
+  bool ok = AgentProtocol::writeAll(fd, frame);
+  std::thread sender([this, fd]
+    {
+      sendCompletions(fd);
+    });
+
+  std::string buffer;
+  while(ok)
+  {
+    char data[4096];
+    ssize_t n = ::read(fd, data, sizeof(data));
+    if(n < 0 && errno == EINTR)
+      continue;
+    ok = n > 0;
+    if(ok)
+      buffer.append(data, n);
+    AgentProtocol::MessageType type;
+    std::string payload;
+    AgentProtocol::FrameStatus frameStatus = AgentProtocol::FRAME_INCOMPLETE;
+    while(ok && (frameStatus = AgentProtocol::extractFrame(buffer, type,
+                                                           payload))
+                == AgentProtocol::FRAME_OK)
+    {
+      ok = type == AgentProtocol::LAUNCH && payload.size() >= 8 + 4;
+      if(!ok)
+        break;
+      std::size_t pos = 0;
+      std::uint64_t launchId = AgentProtocol::getUInt64(payload, pos);
+      unsigned int index = AgentProtocol::getUInt32(payload, pos);
+      std::string descriptor = payload.substr(pos);
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _runningTasks++;
+      }
+      std::thread([this, launchId, index, descriptor]
+        {
+          int status = _handler(index, descriptor);
+          std::unique_lock<std::mutex> lock(_mutex);
+          _completions.emplace_back(launchId, status);
+          _runningTasks--;
+          _condition.notify_all();
+        }).detach();
+    }
+    if(frameStatus == AgentProtocol::FRAME_TOO_BIG)
+      ok = false;
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _condition.wait(lock, [this] {return _runningTasks == 0;});
+    _stop = true;
+    _condition.notify_all();
+  }
+  sender.join();
+  ::close(fd);
+  return true;
+}
+
+void WorkerAgent::sendCompletions(int fd)
+{
+  bool threadStop = false;
+  while(!threadStop)
+  {
+    std::vector<std::pair<std::uint64_t, int> > completions;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _condition.wait(lock, [this]
+        {
+          return !_completions.empty() || _stop;
+        });
+      completions.swap(_completions);
+      threadStop = _stop;
+    }
+    if(completions.empty())
+      continue;
+    // all the completions available are acknowledged by the same frame
+    std::string payload;
+    AgentProtocol::putUInt32(payload, completions.size());
+    for(const std::pair<std::uint64_t, int>& completion : completions)
+    {
+      AgentProtocol::putUInt64(payload, completion.first);
+      AgentProtocol::putUInt32(payload, std::uint32_t(completion.second));
+    }
+    std::string frame;
+    AgentProtocol::appendFrame(frame, AgentProtocol::DONE, payload);
+    AgentProtocol::writeAll(fd, frame);
+  }
+}
+
+}
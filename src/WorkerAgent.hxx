@@ -0,0 +1,66 @@
+// Copyright (C) 2020  CEA/DEN, EDF R&D
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+//
+// See http://www.salome-platform.org/ or email : webmaster.salome@opencascade.com
+//
+#ifndef WORKERAGENT_H
+#define WORKERAGENT_H
+
+#include <string>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+namespace WorkloadManager
+{
+/**
+ * Agent process which runs the tasks of a resource for an AgentServer.
+ * Every task received from the server is run in its own thread by the
+ * handler, which returns the status of the task. The completions are sent
+ * back to the server by batches.
+ */
+class WorkerAgent
+{
+public:
+  // Called with the container index and the descriptor of the task.
+  typedef std::function<int(unsigned int, const std::string&)> Handler;
+
+  WorkerAgent(const std::string& socketPath,
+              const std::string& resourceName,
+              const Handler& handler);
+  WorkerAgent(const WorkerAgent&) = delete;
+  // Connect to the server and run the tasks until the server closes the
+  // connection. Return false if the connection failed.
+  bool run();
+
+private:
+  void sendCompletions(int fd);
+
+private:
+  std::string _socketPath;
+  std::string _resourceName;
+  Handler _handler;
+  std::mutex _mutex;
+  std::condition_variable _condition; // completions or end
+  std::vector<std::pair<std::uint64_t, int> > _completions;
+  unsigned int _runningTasks;
+  bool _stop;
+};
+}
+#endif // WORKERAGENT_H
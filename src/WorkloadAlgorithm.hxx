@@ -20,12 +20,22 @@
 #define WORKLOADALGORITHM_H
 
 #include "Task.hxx"
+#include "CpuTopology.hxx"
+#include <functional>
+#include <chrono>
+#include <string>
 
 namespace WorkloadManager
 {
 class WorkloadAlgorithm
 {
 public:
+  enum PlacementMode
+  {
+    SPREAD, // choose the less loaded resource (default)
+    PACK    // choose the resource with the least free cores (best fit)
+  };
+
   struct LaunchInfo
   {
     bool taskFound=false;
@@ -35,9 +45,66 @@ public:
 
   virtual void addTask(Task* t)=0;
   virtual void addResource(const Resource& r)=0;
+  // Handle of the type, the same as in the RunInfo of the launched tasks.
+  // The type is registered if it is new. The default handle 0 puts all the
+  // types in the same bucket for the admission limits by type (see
+  // WorkloadManager::setMaxQueuedTasks).
+  virtual ContainerTypeHandle registerType(const ContainerType& ctype)
+  {
+    return 0;
+  }
   virtual LaunchInfo chooseTask()=0;
   virtual void liberate(const LaunchInfo& info)=0;
   virtual bool empty()const =0;
+
+  // Choose a waiting task which can be run in the same container after the
+  // launched task (same type, accepted on the same resource, and with its
+  // data on this resource if it has locality hints), for batched runs.
+  // The task is removed from the waiting tasks. Return nullptr if there is
+  // no such task or if the algorithm does not support batches.
+  virtual Task* chooseBatchedTask(const LaunchInfo& launched)
+  {
+    return nullptr;
+  }
+
+  // Remove a waiting task accepted by the function, in order to run it
+  // somewhere else. Return nullptr if there is no such task or if the
+  // algorithm does not support it.
+  virtual Task* removeTask(const std::function<bool(Task*)>& accept)
+  {
+    return nullptr;
+  }
+
+  // The data set is on the resource (see Task::localityHints).
+  virtual void setDataSetLocation(const std::string& dataSet,
+                                  const std::string& resourceName){}
+  // Cost of the transfer of the data and time a task waits for a resource
+  // where its data is, if the algorithm supports data locality.
+  virtual void setTransferCost(float cost){}
+  virtual void setLocalityDelay(const std::chrono::milliseconds& delay){}
+
+  // Placement of the tasks, if the algorithm supports several ones.
+  virtual void setPlacementMode(PlacementMode mode){}
+
+  // Pin the containers of the resource to CPUs. Return false if the
+  // algorithm does not support it (see ResourcePool::setCpuTopology).
+  virtual bool setCpuTopology(const std::string& resourceName,
+                              const CpuTopology& topology)
+  {
+    return false;
+  }
+
+  // Time when chooseTask should be called again even if nothing changed,
+  // for tasks which are delayed on purpose.
+  virtual std::chrono::steady_clock::time_point retryTime()const
+  {
+    return std::chrono::steady_clock::time_point::max();
+  }
+
+  // Called by the manager with the function to call when resources are
+  // released outside of the manager (shared resources). An empty function
+  // removes the previous one.
+  virtual void setResourceListener(const std::function<void()>& listener){}
 };
 }
 #endif // WORKLOADALGORITHM_H
@@ -24,22 +24,112 @@
 #include <map>
 #include <queue>
 #include <list>
+#include <vector>
+#include <unordered_set>
+#include <functional>
+#include <chrono>
+#include <exception>
+#include <pthread.h>
+#include <sched.h>
 #include "Task.hxx"
 #include "WorkloadAlgorithm.hxx"
+#include "TaskJournal.hxx"
 
 namespace WorkloadManager
 {
-  class WorkloadManager
+  // The algorithm is WorkloadAlgorithm or a class derived from it. If the
+  // class is final (ex: PolicyAlgorithm), the calls of the scheduling loop
+  // are not virtual and they can be inlined. WorkloadManager is the
+  // instantiation for any algorithm (plugins).
+  template <class Algo>
+  class BasicWorkloadManager
   {
   public:
-    WorkloadManager(WorkloadAlgorithm& algo);
-    WorkloadManager(const WorkloadManager&) = delete;
-    WorkloadManager()=delete;
-    ~WorkloadManager();
+    BasicWorkloadManager(Algo& algo);
+    BasicWorkloadManager(const BasicWorkloadManager&) = delete;
+    BasicWorkloadManager()=delete;
+    // Wait for the end of the tasks of a started manager (see stop). The
+    // tasks added after stop, or before the first start, are not run: they
+    // stay in the journal, if any, for the next execution.
+    ~BasicWorkloadManager();
+    // Wait until the task is admitted (see setMaxQueuedTasks).
     void addTask(Task* t);
+    // Wait at most timeout. Return false if the task was not admitted.
+    bool addTask(Task* t, const std::chrono::milliseconds& timeout);
+    // Return false at once if the task cannot be admitted.
+    bool tryAddTask(Task* t);
     void addResource(const Resource& r);
+    // The data set is on the resource (see Task::localityHints).
+    void setDataSetLocation(const std::string& dataSet,
+                            const std::string& resourceName);
+    // see WorkloadAlgorithm::setTransferCost and setLocalityDelay
+    void setTransferCost(float cost);
+    void setLocalityDelay(const std::chrono::milliseconds& delay);
+    // see WorkloadAlgorithm::setPlacementMode
+    void setPlacementMode(WorkloadAlgorithm::PlacementMode mode);
+    // see WorkloadAlgorithm::setCpuTopology
+    bool setCpuTopology(const std::string& resourceName,
+                        const CpuTopology& topology);
+    // Admission limits on the number of tasks waiting to be launched.
+    // 0 means no limit, which is the default.
+    void setMaxQueuedTasks(std::size_t max);
+    void setMaxQueuedTasks(const ContainerType& ctype, std::size_t max);
+    // The callback is called with true when the number of waiting tasks
+    // reaches high, and with false when it goes back down to low.
+    // high = 0 disables the watermarks, which is the default.
+    // It is called with the manager lock held and it must not call the
+    // manager.
+    void setWatermarks(std::size_t high, std::size_t low,
+                       const std::function<void(bool)>& callback);
+    // Batched runs: up to maxTasks waiting tasks of the same type, accepted
+    // on the same resource, are run one after the other in the same
+    // container. 1 means no batch, which is the default.
+    void setBatchSize(unsigned int maxTasks);
+    // The size of the batches is adapted to the observed durations of the
+    // tasks of each type, in order for a batch to last about targetDuration.
+    void setAdaptiveBatching(const std::chrono::milliseconds& targetDuration,
+                             unsigned int maxTasks);
+    // Record the submissions and the completions of the tasks with a key
+    // (see Task::key). nullptr means no journal, which is the default.
+    void setJournal(TaskJournal* journal);
+    // After a restart, add again the tasks of the journal which were not
+    // completed. The factory creates the task of a key, or returns nullptr
+    // if the task is not needed any more. The admission limits are not
+    // checked. Return the number of added tasks.
+    std::size_t recoverTasks(const std::function<Task*(const std::string&)>&
+                                                                    factory);
+    // Remove a waiting task accepted by the function, in order to run it
+    // somewhere else (see WorkloadAlgorithm::removeTask).
+    // Return nullptr if there is no such task.
+    Task* takeWaitingTask(const std::function<bool(Task*)>& accept);
+    std::size_t nbWaitingTasks();
+    std::size_t nbRunningTasks();
+    // Number of tasks which ran without the affinity of their CPUs
+    // (see ResourcePool::setCpuTopology).
+    std::size_t nbPinningFailures();
+    // The scheduler threads are created by the first start and they live
+    // until the manager is destroyed, so start and stop cost no thread
+    // creation.
     void start(); //! start execution
+    // Wait for the end of all the tasks (see waitAll) and stop launching
+    // tasks until the next start. It does nothing if the manager is not
+    // started.
     void stop(); //! stop execution
+    // Wait until all the waiting tasks are launched and all the launched
+    // tasks are finished. The manager keeps running.
+    // The waiting tasks are not launched while the manager is stopped or
+    // paused, so it blocks until another thread calls start or resume.
+    void waitAll();
+    // Wait for the end of a task added to this manager. It returns at once
+    // if the task is not waiting nor running. Same as waitAll for a
+    // stopped or paused manager.
+    void wait(const Task* t);
+    // Return false if the task is not finished after timeout.
+    bool wait(const Task* t, const std::chrono::milliseconds& timeout);
+    // No task is launched between pause and resume. The running tasks
+    // go on.
+    void pause();
+    void resume();
 
   private:
     typedef unsigned long TaskId;
@@ -47,6 +137,12 @@ namespace WorkloadManager
     {
       TaskId id;
       WorkloadAlgorithm::LaunchInfo info;
+      std::vector<Task*> batch; // tasks run after info.task
+    };
+    struct Admission
+    {
+      std::size_t max = 0;
+      std::size_t queued = 0;
     };
     std::map<TaskId, std::future<void> > _runningTasks;
     std::queue<RunningInfo> _finishedTasks;
@@ -54,15 +150,673 @@ namespace WorkloadManager
     std::mutex _data_mutex;
     std::condition_variable _startCondition; // start tasks thread notification
     std::condition_variable _endCondition; // end tasks thread notification
-    bool _stop;
-    std::vector< std::future<void> > _otherThreads;
-    WorkloadAlgorithm& _algo;
+    std::condition_variable _doneCondition; // a task is finished
+    bool _started; // between start and stop
+    bool _paused; // between pause and resume
+    bool _exit; // end of the scheduler threads
+    bool _needScheduling; // something changed since the last choice of tasks
+    std::condition_variable _admissionCondition; // a waiting task was launched
+    Admission _admission;
+    std::vector<Admission> _typeAdmissions; // index is the type handle
+    std::size_t _highWatermark;
+    std::size_t _lowWatermark;
+    bool _aboveWatermark;
+    std::function<void(bool)> _watermarkCallback;
+    unsigned int _maxBatchSize;
+    std::chrono::milliseconds _batchDuration; // 0 if not adaptive
+    std::vector<double> _meanDurations; // seconds, index is the type handle
+    TaskJournal* _journal;
+    std::size_t _pinningFailures;
+    std::unordered_multiset<const Task*> _activeTasks; // waiting or running
+    std::vector< std::future<void> > _otherThreads; // scheduler threads
+    Algo& _algo;
 
     void runTasks();
     void endTasks();
-    void runOneTask(const RunningInfo& taskInfo);
+    void runOneTask(RunningInfo taskInfo);
+    // Return false if the affinity is not set.
+    static bool pinCurrentThread(const std::vector<int>& cpus);
     // choose a task and block a resource
     bool chooseTaskToRun(RunningInfo& taskInfo);
+    // The following functions are called under the lock.
+    bool isAdmissible(ContainerTypeHandle typeHandle);
+    Admission& typeAdmission(ContainerTypeHandle typeHandle);
+    bool isLaunching()const;
+    bool isIdle()const;
+    void recordCompleted(const RunningInfo& taskInfo);
+    // Unlock during the copy of the journal (see TaskJournal::Compaction).
+    void compactJournal(std::unique_lock<std::mutex>& lock);
+    void queueTask(Task* t, ContainerTypeHandle typeHandle);
+    void updateWatermark();
+    void taskDequeued(ContainerTypeHandle typeHandle);
+    unsigned int batchSize(const RunInfo& worker)const;
   };
+
+  template <class Algo>
+  BasicWorkloadManager<Algo>::BasicWorkloadManager(Algo& algo)
+  : _runningTasks()
+  , _finishedTasks()
+  , _nextIndex(0)
+  , _data_mutex()
+  , _startCondition()
+  , _endCondition()
+  , _doneCondition()
+  , _started(false)
+  , _paused(false)
+  , _exit(false)
+  , _needScheduling(false)
+  , _admissionCondition()
+  , _admission()
+  , _typeAdmissions()
+  , _highWatermark(0)
+  , _lowWatermark(0)
+  , _aboveWatermark(false)
+  , _watermarkCallback()
+  , _maxBatchSize(1)
+  , _batchDuration(0)
+  , _meanDurations()
+  , _journal(nullptr)
+  , _pinningFailures(0)
+  , _activeTasks()
+  , _otherThreads()
+  , _algo(algo)
+  {
+    _algo.setResourceListener([this]
+      {
+        {
+          std::unique_lock<std::mutex> lock(_data_mutex);
+          _needScheduling = true;
+        }
+        _startCondition.notify_one();
+      });
+  }
+  
+  template <class Algo>
+  BasicWorkloadManager<Algo>::~BasicWorkloadManager()
+  {
+    stop();
+    {
+      std::unique_lock<std::mutex> lock(_data_mutex);
+      _exit = true;
+    }
+    _startCondition.notify_one();
+    _endCondition.notify_one();
+    for(std::future<void>& th : _otherThreads)
+      th.wait();
+    _algo.setResourceListener(nullptr);
+  }
+  
+  template <class Algo>
+  void BasicWorkloadManager<Algo>::addResource(const Resource& r)
+  {
+    std::unique_lock<std::mutex> lock(_data_mutex);
+    _algo.addResource(r);
+    _needScheduling = true;
+    _startCondition.notify_one();
+  }
+  
+  template <class Algo>
+  void BasicWorkloadManager<Algo>::setDataSetLocation
+                                (const std::string& dataSet,
+                                 const std::string& resourceName)
+  {
+    std::unique_lock<std::mutex> lock(_data_mutex);
+    _algo.setDataSetLocation(dataSet, resourceName);
+  }
+
+  template <class Algo>
+  void BasicWorkloadManager<Algo>::setTransferCost(float cost)
+  {
+    std::unique_lock<std::mutex> lock(_data_mutex);
+    _algo.setTransferCost(cost);
+  }
+
+  template <class Algo>
+  void BasicWorkloadManager<Algo>::setLocalityDelay
+                                (const std::chrono::milliseconds& delay)
+  {
+    {
+      std::unique_lock<std::mutex> lock(_data_mutex);
+      _algo.setLocalityDelay(delay);
+      // the delayed tasks may be launched earlier
+      _needScheduling = true;
+    }
+    _startCondition.notify_one();
+  }
+
+  template <class Algo>
+  void BasicWorkloadManager<Algo>::setPlacementMode
+                                (WorkloadAlgorithm::PlacementMode mode)
+  {
+    std::unique_lock<std::mutex> lock(_data_mutex);
+    _algo.setPlacementMode(mode);
+  }
+
+  template <class Algo>
+  bool BasicWorkloadManager<Algo>::setCpuTopology
+                                (const std::string& resourceName,
+                                 const CpuTopology& topology)
+  {
+    std::unique_lock<std::mutex> lock(_data_mutex);
+    return _algo.setCpuTopology(resourceName, topology);
+  }
+
+  template <class Algo>
+  void BasicWorkloadManager<Algo>::addTask(Task* t)
+  {
+    std::unique_lock<std::mutex> lock(_data_mutex);
+    ContainerTypeHandle typeHandle = _algo.registerType(t->type());
+    _admissionCondition.wait(lock, [this, typeHandle]
+                             {
+                               return isAdmissible(typeHandle);
+                             });
+    queueTask(t, typeHandle);
+  }
+
+  template <class Algo>
+  bool BasicWorkloadManager<Algo>::addTask
+                                (Task* t,
+                                 const std::chrono::milliseconds& timeout)
+  {
+    std::unique_lock<std::mutex> lock(_data_mutex);
+    ContainerTypeHandle typeHandle = _algo.registerType(t->type());
+    if(!_admissionCondition.wait_for(lock, timeout, [this, typeHandle]
+                                     {
+                                       return isAdmissible(typeHandle);
+                                     }))
+      return false;
+    queueTask(t, typeHandle);
+    return true;
+  }
+
+  template <class Algo>
+  bool BasicWorkloadManager<Algo>::tryAddTask(Task* t)
+  {
+    std::unique_lock<std::mutex> lock(_data_mutex);
+    ContainerTypeHandle typeHandle = _algo.registerType(t->type());
+    if(!isAdmissible(typeHandle))
+      return false;
+    queueTask(t, typeHandle);
+    return true;
+  }
+
+  template <class Algo>
+  void BasicWorkloadManager<Algo>::setMaxQueuedTasks(std::size_t max)
+  {
+    std::unique_lock<std::mutex> lock(_data_mutex);
+    _admission.max = max;
+    _admissionCondition.notify_all();
+  }
+
+  template <class Algo>
+  void BasicWorkloadManager<Algo>::setMaxQueuedTasks
+                                (const ContainerType& ctype, std::size_t max)
+  {
+    std::unique_lock<std::mutex> lock(_data_mutex);
+    typeAdmission(_algo.registerType(ctype)).max = max;
+    _admissionCondition.notify_all();
+  }
+
+  template <class Algo>
+  void BasicWorkloadManager<Algo>::setWatermarks
+                                (std::size_t high, std::size_t low,
+                                 const std::function<void(bool)>& callback)
+  {
+    std::unique_lock<std::mutex> lock(_data_mutex);
+    _highWatermark = high;
+    _lowWatermark = low;
+    _watermarkCallback = callback;
+    _aboveWatermark = false;
+    updateWatermark();
+  }
+
+  template <class Algo>
+  void BasicWorkloadManager<Algo>::setJournal(TaskJournal* journal)
+  {
+    std::unique_lock<std::mutex> lock(_data_mutex);
+    _journal = journal;
+  }
+
+  template <class Algo>
+  std::size_t BasicWorkloadManager<Algo>::recoverTasks
+                  (const std::function<Task*(const std::string&)>& factory)
+  {
+    std::unique_lock<std::mutex> lock(_data_mutex);
+    if(_journal == nullptr)
+      return 0;
+    std::size_t result = 0;
+    for(const std::string& key : _journal->pendingKeys())
+    {
+      Task* t = factory(key);
+      if(t)
+      {
+        queueTask(t, _algo.registerType(t->type()));
+        result++;
+      }
+    }
+    return result;
+  }
+
+  template <class Algo>
+  Task* BasicWorkloadManager<Algo>::takeWaitingTask
+                                (const std::function<bool(Task*)>& accept)
+  {
+    std::unique_lock<std::mutex> lock(_data_mutex);
+    Task* result = _algo.removeTask(accept);
+    if(result)
+    {
+      // not a task of this manager any more
+      _activeTasks.erase(_activeTasks.find(result));
+      _doneCondition.notify_all();
+      taskDequeued(_algo.registerType(result->type()));
+      updateWatermark();
+      _admissionCondition.notify_all();
+    }
+    return result;
+  }
+
+  template <class Algo>
+  std::size_t BasicWorkloadManager<Algo>::nbWaitingTasks()
+  {
+    std::unique_lock<std::mutex> lock(_data_mutex);
+    return _admission.queued;
+  }
+
+  template <class Algo>
+  std::size_t BasicWorkloadManager<Algo>::nbRunningTasks()
+  {
+    std::unique_lock<std::mutex> lock(_data_mutex);
+    return _runningTasks.size();
+  }
+
+  template <class Algo>
+  std::size_t BasicWorkloadManager<Algo>::nbPinningFailures()
+  {
+    std::unique_lock<std::mutex> lock(_data_mutex);
+    return _pinningFailures;
+  }
+
+  template <class Algo>
+  void BasicWorkloadManager<Algo>::start()
+  {
+    {
+      std::unique_lock<std::mutex> lock(_data_mutex);
+      _started = true;
+      _needScheduling = true;
+    }
+    if(_otherThreads.empty())
+    {
+      _otherThreads.emplace_back(std::async(std::launch::async, [this]
+        {
+          runTasks();
+        }));
+      _otherThreads.emplace_back(std::async(std::launch::async, [this]
+        {
+          endTasks();
+        }));
+    }
+    _startCondition.notify_one();
+  }
+
+  template <class Algo>
+  void BasicWorkloadManager<Algo>::stop()
+  {
+    {
+      std::unique_lock<std::mutex> lock(_data_mutex);
+      if(!_started)
+        return;
+      // the waiting tasks have to be launched
+      _paused = false;
+      _needScheduling = true;
+    }
+    _startCondition.notify_one();
+    waitAll();
+    std::unique_lock<std::mutex> lock(_data_mutex);
+    _started = false;
+  }
+
+  template <class Algo>
+  void BasicWorkloadManager<Algo>::waitAll()
+  {
+    std::unique_lock<std::mutex> lock(_data_mutex);
+    _doneCondition.wait(lock, [this] {return isIdle();});
+  }
+
+  template <class Algo>
+  void BasicWorkloadManager<Algo>::wait(const Task* t)
+  {
+    std::unique_lock<std::mutex> lock(_data_mutex);
+    _doneCondition.wait(lock, [this, t] {return _activeTasks.count(t) == 0;});
+  }
+
+  template <class Algo>
+  bool BasicWorkloadManager<Algo>::wait
+                                (const Task* t,
+                                 const std::chrono::milliseconds& timeout)
+  {
+    std::unique_lock<std::mutex> lock(_data_mutex);
+    return _doneCondition.wait_for(lock, timeout, [this, t]
+                                   {
+                                     return _activeTasks.count(t) == 0;
+                                   });
+  }
+
+  template <class Algo>
+  void BasicWorkloadManager<Algo>::pause()
+  {
+    std::unique_lock<std::mutex> lock(_data_mutex);
+    _paused = true;
+  }
+
+  template <class Algo>
+  void BasicWorkloadManager<Algo>::resume()
+  {
+    {
+      std::unique_lock<std::mutex> lock(_data_mutex);
+      _paused = false;
+      _needScheduling = true;
+    }
+    _startCondition.notify_one();
+  }
+
+  template <class Algo>
+  void BasicWorkloadManager<Algo>::runTasks()
+  {
+    auto wakeUp = [this]
+      {
+        return _exit || (_needScheduling && isLaunching());
+      };
+    while(true)
+    {
+      std::unique_lock<std::mutex> lock(_data_mutex);
+      // Wait for new tasks, new resources or released resources.
+      // Some tasks may also be delayed by the algorithm, but nothing is
+      // launched before start or resume.
+      std::chrono::steady_clock::time_point retryTime;
+      if(isLaunching())
+        retryTime = _algo.retryTime();
+      else
+        retryTime = std::chrono::steady_clock::time_point::max();
+      if(retryTime == std::chrono::steady_clock::time_point::max())
+        _startCondition.wait(lock, wakeUp);
+      else
+        _startCondition.wait_until(lock, retryTime, wakeUp);
+      if(_exit)
+        break;
+      if(!isLaunching())
+        continue;
+      _needScheduling = false;
+      RunningInfo taskInfo;
+      while(chooseTaskToRun(taskInfo))
+      {
+        // The batch is moved to the thread of the task, not copied.
+        TaskId id = taskInfo.id;
+        _runningTasks.emplace(id, std::async(std::launch::async,
+                                             &BasicWorkloadManager::runOneTask,
+                                             this, std::move(taskInfo)));
+      }
+    }
+  }
+
+  template <class Algo>
+  void BasicWorkloadManager<Algo>::runOneTask(RunningInfo taskInfo)
+  {
+    std::chrono::steady_clock::time_point start;
+    start = std::chrono::steady_clock::now();
+    // Every task has its own thread, so the affinity ends with the task.
+    // The task runs anyway if the CPUs are not available.
+    bool pinned = true;
+    if(taskInfo.info.worker.cpus)
+      pinned = pinCurrentThread(*taskInfo.info.worker.cpus);
+    taskInfo.info.task->run(taskInfo.info.worker);
+    for(Task* t : taskInfo.batch)
+      t->run(taskInfo.info.worker);
+    std::chrono::duration<double> duration;
+    duration = std::chrono::steady_clock::now() - start;
+
+    {
+      std::unique_lock<std::mutex> lock(_data_mutex);
+      if(!pinned)
+        _pinningFailures++;
+      if(_batchDuration.count() > 0)
+      {
+        // exponential moving average of the durations of the tasks
+        double taskDuration = duration.count() / (taskInfo.batch.size() + 1);
+        ContainerTypeHandle typeHandle = taskInfo.info.worker.typeHandle;
+        if(typeHandle >= _meanDurations.size())
+          _meanDurations.resize(typeHandle + 1, 0.0);
+        double& meanDuration = _meanDurations[typeHandle];
+        if(meanDuration == 0.0)
+          meanDuration = taskDuration;
+        else
+          meanDuration = 0.8 * meanDuration + 0.2 * taskDuration;
+      }
+      _finishedTasks.push(std::move(taskInfo));
+      _endCondition.notify_one();
+    }
+  }
+
+  template <class Algo>
+  bool BasicWorkloadManager<Algo>::pinCurrentThread
+                                (const std::vector<int>& cpus)
+  {
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    for(int cpu : cpus)
+      if(cpu >= 0 && cpu < CPU_SETSIZE)
+        CPU_SET(cpu, &cpuSet);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t),
+                                  &cpuSet) == 0;
+  }
+
+  template <class Algo>
+  void BasicWorkloadManager<Algo>::endTasks()
+  {
+    bool threadStop = false;
+    while(!threadStop)
+    {
+      std::unique_lock<std::mutex> lock(_data_mutex);
+      _endCondition.wait(lock, [this]
+                            {
+                              return !_finishedTasks.empty() ||
+                              (_exit && _runningTasks.empty());
+                            });
+      while(!_finishedTasks.empty())
+      {
+        RunningInfo taskInfo = std::move(_finishedTasks.front());
+        _finishedTasks.pop();
+        _runningTasks[taskInfo.id].wait();
+        _runningTasks.erase(taskInfo.id);
+        _algo.liberate(taskInfo.info);
+        recordCompleted(taskInfo);
+        _activeTasks.erase(_activeTasks.find(taskInfo.info.task));
+        for(const Task* t : taskInfo.batch)
+          _activeTasks.erase(_activeTasks.find(t));
+        _needScheduling = true;
+      }
+      compactJournal(lock);
+      threadStop = _exit && _runningTasks.empty();
+      _startCondition.notify_one();
+      _doneCondition.notify_all();
+    }
+  }
+
+  template <class Algo>
+  bool BasicWorkloadManager<Algo>::chooseTaskToRun(RunningInfo& taskInfo)
+  {
+    // We are already under the lock
+    taskInfo.id = _nextIndex;
+    taskInfo.info = _algo.chooseTask();
+    taskInfo.batch.clear();
+    if(taskInfo.info.taskFound)
+    {
+      _nextIndex ++;
+      taskDequeued(taskInfo.info.worker.typeHandle);
+      unsigned int maxBatchSize = batchSize(taskInfo.info.worker);
+      while(taskInfo.batch.size() + 1 < maxBatchSize)
+      {
+        Task* t = _algo.chooseBatchedTask(taskInfo.info);
+        if(t == nullptr)
+          break;
+        taskInfo.batch.push_back(t);
+        taskDequeued(taskInfo.info.worker.typeHandle);
+      }
+      updateWatermark();
+      _admissionCondition.notify_all();
+    }
+    return taskInfo.info.taskFound;
+  }
+
+  template <class Algo>
+  void BasicWorkloadManager<Algo>::taskDequeued(ContainerTypeHandle typeHandle)
+  {
+    _admission.queued--;
+    typeAdmission(typeHandle).queued--;
+  }
+
+  template <class Algo>
+  unsigned int BasicWorkloadManager<Algo>::batchSize(const RunInfo& worker)const
+  {
+    if(_maxBatchSize <= 1 || _batchDuration.count() == 0)
+      return _maxBatchSize;
+    // adaptive batching
+    if(worker.typeHandle >= _meanDurations.size()
+       || _meanDurations[worker.typeHandle] == 0.0)
+      return 1; // no duration observed yet
+    std::chrono::duration<double> target = _batchDuration;
+    double result = target.count() / _meanDurations[worker.typeHandle];
+    if(result < 1.0)
+      return 1;
+    if(result > _maxBatchSize)
+      return _maxBatchSize;
+    return result;
+  }
+
+  template <class Algo>
+  void BasicWorkloadManager<Algo>::setBatchSize(unsigned int maxTasks)
+  {
+    std::unique_lock<std::mutex> lock(_data_mutex);
+    _maxBatchSize = maxTasks;
+    _batchDuration = std::chrono::milliseconds(0);
+  }
+
+  template <class Algo>
+  void BasicWorkloadManager<Algo>::setAdaptiveBatching
+                             (const std::chrono::milliseconds& targetDuration,
+                              unsigned int maxTasks)
+  {
+    std::unique_lock<std::mutex> lock(_data_mutex);
+    _maxBatchSize = maxTasks;
+    _batchDuration = targetDuration;
+  }
+
+  template <class Algo>
+  bool BasicWorkloadManager<Algo>::isLaunching()const
+  {
+    return _started && !_paused;
+  }
+
+  template <class Algo>
+  bool BasicWorkloadManager<Algo>::isIdle()const
+  {
+    return _algo.empty() && _runningTasks.empty();
+  }
+
+  template <class Algo>
+  bool BasicWorkloadManager<Algo>::isAdmissible(ContainerTypeHandle typeHandle)
+  {
+    if(_admission.max > 0 && _admission.queued >= _admission.max)
+      return false;
+    const Admission& admission = typeAdmission(typeHandle);
+    return admission.max == 0 || admission.queued < admission.max;
+  }
+
+  template <class Algo>
+  typename BasicWorkloadManager<Algo>::Admission&
+  BasicWorkloadManager<Algo>::typeAdmission(ContainerTypeHandle typeHandle)
+  {
+    if(typeHandle >= _typeAdmissions.size())
+      _typeAdmissions.resize(typeHandle + 1);
+    return _typeAdmissions[typeHandle];
+  }
+
+  template <class Algo>
+  void BasicWorkloadManager<Algo>::recordCompleted(const RunningInfo& taskInfo)
+  {
+    if(_journal == nullptr)
+      return;
+    try
+    {
+      const std::string& key = taskInfo.info.task->key();
+      if(!key.empty())
+        _journal->recordCompleted(key);
+      for(const Task* t : taskInfo.batch)
+        if(!t->key().empty())
+          _journal->recordCompleted(t->key());
+    }
+    catch(const std::exception&)
+    {
+      // The journal cannot grow. The task will be run again after a
+      // restart.
+    }
+  }
+
+  template <class Algo>
+  void BasicWorkloadManager<Algo>::compactJournal
+                                (std::unique_lock<std::mutex>& lock)
+  {
+    if(_journal == nullptr || !_journal->needsCompaction())
+      return;
+    // The journal is only read by writeCompaction, so the new file is
+    // written and flushed without the lock.
+    TaskJournal* journal = _journal;
+    TaskJournal::Compaction compaction;
+    journal->beginCompaction(compaction);
+    lock.unlock();
+    journal->writeCompaction(compaction);
+    lock.lock();
+    journal->endCompaction(compaction);
+  }
+
+  template <class Algo>
+  void BasicWorkloadManager<Algo>::queueTask(Task* t,
+                                             ContainerTypeHandle typeHandle)
+  {
+    if(_journal)
+    {
+      const std::string& key = t->key();
+      if(!key.empty())
+        _journal->recordSubmitted(key);
+    }
+    _algo.addTask(t);
+    _activeTasks.insert(t);
+    _admission.queued++;
+    typeAdmission(typeHandle).queued++;
+    updateWatermark();
+    _needScheduling = true;
+    _startCondition.notify_one();
+  }
+
+  template <class Algo>
+  void BasicWorkloadManager<Algo>::updateWatermark()
+  {
+    if(!_watermarkCallback || _highWatermark == 0)
+      return;
+    if(!_aboveWatermark && _admission.queued >= _highWatermark)
+    {
+      _aboveWatermark = true;
+      _watermarkCallback(true);
+    }
+    else if(_aboveWatermark && _admission.queued <= _lowWatermark)
+    {
+      _aboveWatermark = false;
+      _watermarkCallback(false);
+    }
+  }
+
+  // The manager of the plugins: the algorithm is called through the virtual
+  // interface (see WorkloadManager.cxx).
+  typedef BasicWorkloadManager<WorkloadAlgorithm> WorkloadManager;
+  extern template class BasicWorkloadManager<WorkloadAlgorithm>;
 }
 #endif // WORKLOADMANAGER_H